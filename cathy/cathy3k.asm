@@ -44,6 +44,9 @@
 ;
 ;  - Added command to read and write to serial flash memory
 ;
+;  - Added extended address command 'H' for serial flash carts larger than 16MB
+;    (CART_EXT_ADDRESS builds only)
+;
 ;  - Sketch self flashing support through vector at 0x7FFC
 ;
 ;  - Software bootloader area protection to protect from accidental overwrites
@@ -112,6 +115,11 @@
 ; #define LCD_ST7565        //;for Arduboy clones using ST7565 LCD displays with
 ;                           //;RGB backlight and Power LED
 
+; #define CART_EXT_ADDRESS  //;adds extended address command 'H' for serial
+;                           //;flash carts larger than 16MB. Needs 8 bytes in
+;                           //;.boot and 26 bytes in .text which the DevKit
+;                           //;and SSD132X builds don't have
+
 ;the DEVICE_VID and DEVICE_PID will determine for which board the build will be
 ;made. (Arduino Leonardo, Arduino Micro, Arduino Esplora, SparkFun ProMicro)
 
@@ -160,6 +168,9 @@
 #define SFC_READ_STATUS1            0x05
 #define SFC_WRITE_ENABLE            0x06
 #define SFC_SECTOR_ERASE            0x20
+#define SFC_SECTOR_ERASE4           0x21
+#define SFC_PAGE_PROGRAM4           0x12
+#define SFC_READ_DATA4              0x13
 #define SFC_JEDEC_ID                0x9F
 #define SFC_RELEASE_POWERDOWN       0xAB
 #define SFC_POWERDOWN               0xB9
@@ -786,6 +797,8 @@ SECTION_DATA_END:
 ;   r4, r5  Current Adrress
 ;   r6, r7  Current application page
 ;   r8      Current list
+;   r9      Current cart address bits 31-24 (set by 'H', cleared by 'A',
+;           CART_EXT_ADDRESS builds only)
 ;-------------------------------------------------------------------------------
 ;Reset Vector
 
@@ -1220,14 +1233,29 @@ CDC_Task_Command_L:         ;-----------------------------------leave programmin
                             rjmp    CDC_Task_Response
 CDC_Task_Command_a:         ;-----------------------------------auto address increment inquiry
                             cpi     r24, 'a'
+                          #ifdef CART_EXT_ADDRESS
+                            brne    CDC_Task_Command_H
+                          #else
                             brne    CDC_Task_Command_A
+                          #endif
 
                             ldi     r24, 'Y'                    ;'Y'es supported
                             rjmp    CDC_Task_Response
+                          #ifdef CART_EXT_ADDRESS
+CDC_Task_Command_H:         ;-----------------------------------set extended address (flash carts > 16MB)
+                            cpi     r24, 'H'
+                            brne    CDC_Task_Command_A
+
+                            rjmp    CDC_Task_Set_ext_addr       ;in text section, continues below
+                          #endif
 CDC_Task_Command_A:         ;-----------------------------------set current address / flash sector
                             cpi     r24, 'A'
                             brne    CDC_Task_Command_p
 
+                          #ifdef CART_EXT_ADDRESS
+                            clr     r9                          ;3-byte cart addresses
+CDC_Task_Set_addr:
+                          #endif
                             rcall   FetchNextCommandByte
                             mov     r5, r24
                             rcall   FetchNextCommandByte
@@ -1404,7 +1432,11 @@ CDC_Task_ReadBlk:
                             ;read SPI flash cart
 
                             ldi     r24, SFC_READ_DATA
+                          #ifdef CART_EXT_ADDRESS
+                            rcall   SPI_flash_cmd_ext_addr      ;send read command, set address
+                          #else
                             rcall   SPI_flash_cmd_addr          ;send read command, set address
+                          #endif
 CDC_Task_ReadBlk_cart:
                             rcall   SPI_transfer
                             rcall   WriteNextResponseByte
@@ -1443,12 +1475,20 @@ CDC_Task_Write_cart_sector:
 
                             rcall   SPI_write_enable
                             ldi     r24, SFC_SECTOR_ERASE
+                          #ifdef CART_EXT_ADDRESS
+                            rcall   SPI_flash_cmd_ext_addr
+                          #else
                             rcall   SPI_flash_cmd_addr
+                          #endif
                             rcall   SPI_flash_wait
 CDC_Task_Write_cart_page:
                             rcall   SPI_write_enable
                             ldi     r24, SFC_PAGE_PROGRAM
+                          #ifdef CART_EXT_ADDRESS
+                            rcall   SPI_flash_cmd_ext_addr
+                          #else
                             rcall   SPI_flash_cmd_addr
+                          #endif
 CDC_Task_Write_cart_data:
                             rcall   FetchNextCommandByte        ;write page data
                             rcall   SPI_transfer
@@ -2520,6 +2560,39 @@ SPI_write_enable:
 SPI_flash_cmd_deselect:
                             rcall   SPI_flash_cmd
                             rjmp    SPI_flash_deselect
+                        #ifdef CART_EXT_ADDRESS
+;-------------------------------------------------------------------------------
+CDC_Task_Set_ext_addr:
+
+;'H' command continued: address bits 31-24 followed by the 'A' address bytes
+
+                            rcall   FetchNextCommandByte
+                            mov     r9, r24
+                            rjmp    CDC_Task_Set_addr
+;-------------------------------------------------------------------------------
+SPI_flash_cmd_ext_addr:
+
+;Send SPI command and sets flash sector address above 16MB when r9 is set.
+;Uses the 4-byte address commands so flash carts up to 16MB never see them
+;
+;entry:
+;        r24 = SFC_READ_DATA, SFC_PAGE_PROGRAM or SFC_SECTOR_ERASE
+;        r9  = address bits 31-24
+;        Z   = page address
+;uses:
+;        r24, r25
+                            tst     r9
+                            breq    SPI_flash_cmd_addr  ;3-byte address
+                            cpi     r24, SFC_SECTOR_ERASE
+                            brne    SPI_flash_cmd_ext_addr_rw
+                            ldi     r24, SFC_SECTOR_ERASE4 - 0x10
+SPI_flash_cmd_ext_addr_rw:
+                            subi    r24, -0x10          ;SFC_READ_DATA4, SFC_PAGE_PROGRAM4
+                            rcall   SPI_flash_cmd
+                            mov     r24, r9
+                            rcall   SPI_transfer        ;address bits 31-24
+                            rjmp    SPI_flash_addr
+                        #endif
 ;-------------------------------------------------------------------------------
 SPI_flash_read_addr:
                             ldi     r24, SFC_READ_DATA
@@ -2535,6 +2608,7 @@ SPI_flash_cmd_addr:
 ;uses:
 ;        r24, r25
                             rcall   SPI_flash_cmd       ;select SPI flash and send command
+SPI_flash_addr:
                             mov     r24, r31
                             rcall   SPI_transfer        ;address bits 23-16
                             mov     r24, r30
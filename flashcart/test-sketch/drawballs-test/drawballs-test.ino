@@ -15,11 +15,33 @@
 
 #include <Arduboy2.h>
 #include "src/cart.h"
+#include "src/cartscroller.h"
+#include "src/cartworld.h"
+#include "src/cartspritecache.h"
+#include "src/cartbackdrop.h"
+#include "src/cartmusic.h"
+#include "src/cartgray.h"
+#include "src/cartoverlay.h"
 
 #define PROGRAM_DATA_PAGE 0xFFFE  //value given by flashcart-writer.py script using -d option
 #define FRAME_RATE 60
 
-#define MAX_BALLS 55
+//#define INCREMENTAL_SCROLL // keep the background in a buffer and only read newly exposed tiles from flash
+//#define COLLISION_TEST     // test all balls for pixel collisions with the first ball and show time used
+//#define WORLD_STREAMING    // read tiles from chunks streamed into RAM and show a frame time histogram
+//#define FLIP_TEST          // mirror balls in their direction of movement and show time used to draw the balls
+//#define SPRITE_CACHE       // draw balls from a RAM copy of the ball sprite and show time used to draw the balls
+//#define HUD_LAYER          // compose a panel of balls once and copy it to the screen every frame
+//#define DIRTY_RECTS        // show a fixed background image and only restore the areas drawn over by the balls
+//#define MUSIC              // play music streamed from flash in a timer interrupt and show the interrupt time and the time used to draw the balls
+//#define GRAYSCALE          // draw gray balls by showing two bitplanes in turn and show the plane rate reached
+//#define OVERLAY_TEST       // swap two code modules into internal flash every 2 seconds and show the load time and flash pages written and skipped (not with MUSIC, both use timer 1)
+
+#ifdef INCREMENTAL_SCROLL
+  #define MAX_BALLS 24          // background buffer uses 1K of RAM
+#else
+  #define MAX_BALLS 55
+#endif
 #define CIRCLE_POINTS 84
 #define VISABLE_TILES_PER_COLUMN 5
 #define VISABLE_TILES_PER_ROW 9
@@ -32,12 +54,19 @@ constexpr uint8_t ballHeight = 16;
 
 constexpr uint24_t tilemap = 0x000088; // 16 x 16 tilemap offset in external flash
 constexpr uint8_t tilemapWidth = 16;   // number of tiles in a tilemap row
+constexpr uint24_t backdropImage = 0x000188; // full screen view of the tilemap at map location 16,16 (used by DIRTY_RECTS)
+constexpr uint24_t song = 0x000588;          // xmastree-minigame background music converted by music-converter.py (used by MUSIC)
+constexpr uint24_t gfx3 = 0x00068C;          // masked gray ball sprite converted by gray-converter.py (used by GRAYSCALE)
 constexpr uint8_t tileWidth  = 16;
 constexpr uint8_t tileHeight = 16;
 
+constexpr CartSprite tileSprites = cartSprite(gfx1, tileWidth, tileHeight); // dimensions known at compile time so drawing
+constexpr CartSprite ballSprite  = cartSprite(gfx2, ballWidth, ballHeight); // does not read the bitmap header from flash
+constexpr CartSprite grayBallSprite = cartSprite(gfx3, ballWidth, ballHeight);
+
 Arduboy2 arduboy;
 
-Point circlePoints[CIRCLE_POINTS] = // all the points of a circle with radius 15 used for the circling background effect
+const Point circlePoints[CIRCLE_POINTS] PROGMEM = // all the points of a circle with radius 15 used for the circling background effect
 {
   {-15,0},  {-15,1},   {-15,2},   {-15,3},  {-15,4},  {-14,5},  {-14,6},  {-13,7},  {-13,8},  {-12,9},   {-11,10},  {-10,11}, {-9,12},  {-8,13},  {-7,13},  {-6,14},
   {-5,14},  {-4,14},   {-3,15},   {-2,15},  {-1,15},  {0,15},   {1,15},   {2,15},   {3,15},   {4,14},    {5,14},    {6,14},   {7,13},   {8,13},   {9,12},   {10,11},
@@ -62,11 +91,98 @@ uint8_t ballsVisible = MAX_BALLS;
 
 uint8_t pos;
 
+#ifdef INCREMENTAL_SCROLL
+uint8_t backgroundBuffer[WIDTH * HEIGHT / 8];
+CartScroller scroller;
+#endif
+
+#ifdef SPRITE_CACHE
+uint8_t spriteArena[64];       // room for one 16 x 16 masked frame
+CartSpriteCache spriteCache;
+#endif
+
+#ifdef HUD_LAYER
+uint8_t hudBuffer[48 * 2];     // 48 x 16 pixel panel
+CartTarget hud = {hudBuffer, 48, 2};
+#endif
+
+#ifdef DIRTY_RECTS
+CartBackdrop backdrop;
+#endif
+
+#ifdef MUSIC
+CartMusic music;
+volatile uint16_t musicCycles; // longest interrupt time in CPU cycles
+
+ISR(TIMER1_COMPA_vect)
+{
+  music.tick();
+  uint16_t cycles = TCNT1 << 3;  // timer 1 restarted at the compare match and counts at clock / 8
+  if (cycles > musicCycles) musicCycles = cycles;
+}
+#endif
+
+#ifdef GRAYSCALE
+CartGray gray;
+uint16_t planeRate;            // planes shown in the last second
+unsigned long rateStart;
+#endif
+
+#ifdef OVERLAY_TEST
+constexpr uint24_t overlayModule1 = 0x000000; // program data offsets of two modules linked for overlayRegion, converted by
+constexpr uint24_t overlayModule2 = 0x000000; // overlay-converter.py and appended to drawballs-test.bin (see flashcart/tools/readme.md)
+const uint8_t overlayRegion[1024] PROGMEM __attribute__((aligned(CART_OVERLAY_PAGE_SIZE))) = {};
+CartOverlay overlay;
+bool overlayReady;
+uint32_t overlayLoadTime;      // in us, longest swap shown
+#endif
+
+#ifdef WORLD_STREAMING
+#define HISTOGRAM_BUCKETS 16   // frame time histogram in 1024us buckets
+constexpr uint8_t tilemapHeight = 16;
+CartWorld world;
+uint16_t histogram[HISTOGRAM_BUCKETS];
+#endif
+
 void setup() {
   arduboy.begin();
   arduboy.setFrameRate(FRAME_RATE);
   Cart::disableOLED(); // OLED must be disabled before cart can be used. OLED display should only be enabled prior updating the display.
   Cart::begin(PROGRAM_DATA_PAGE); // wakeup flash chip, initialize datapage, detect presence of flash chip
+ #ifdef INCREMENTAL_SCROLL
+  scroller.begin(backgroundBuffer, tilemap, tilemapWidth, gfx1, tileWidth, tileHeight);
+ #endif
+ #ifdef SPRITE_CACHE
+  spriteCache.begin(spriteArena, sizeof(spriteArena));
+ #endif
+ #ifdef HUD_LAYER
+  Cart::setTarget(hud.buffer, hud.width, hud.pages); // draw the panel once
+  for (uint8_t i = 0; i < 3; i++) Cart::drawBitmap(i * ballWidth, 0, ballSprite, 0, dbmMasked | dbmReverse);
+  Cart::resetTarget();
+ #endif
+ #ifdef DIRTY_RECTS
+  backdrop.begin(backdropImage); // first restore copies the whole image
+ #endif
+ #ifdef WORLD_STREAMING
+  world.begin(tilemap, tilemapWidth, tilemapHeight, tileWidth, tileHeight);
+ #endif
+ #ifdef MUSIC
+  arduboy.audio.on();
+  music.begin();
+  music.play(song, true);
+  TCCR1A = 0;                                 // timer 1 interrupt at CART_MUSIC_TICK_HZ
+  TCCR1B = _BV(WGM12) | _BV(CS11);            // CTC mode, clock / 8
+  OCR1A  = F_CPU / 8 / CART_MUSIC_TICK_HZ - 1;
+  TIMSK1 = _BV(OCIE1A);
+ #endif
+ #ifdef GRAYSCALE
+  gray.begin();
+ #endif
+ #ifdef OVERLAY_TEST
+  overlayReady = overlay.begin(overlayRegion, sizeof(overlayRegion));
+  TCCR1A = 0;                                 // timer 1 counts at clock / 256 to time module loads. micros() falls behind
+  TCCR1B = _BV(CS12);                         // while flash pages are programmed with interrupts disabled
+ #endif
   
   for (uint8_t i=0; i < MAX_BALLS; i++) // initialize ball sprites
   {
@@ -82,50 +198,206 @@ void setup() {
 uint8_t tilemapBuffer[VISABLE_TILES_PER_ROW]; // a small buffer to store one horizontal row of tiles from the tilemap
 
 void loop() {
+ #ifdef GRAYSCALE
+  if (!gray.nextPlane()) return;    // the scene is drawn for each plane
+  bool moving = gray.frameStart();  // all planes of a gray frame show the same scene
+ #else
   if (!arduboy.nextFrame()) return;
+  constexpr bool moving = true;
+ #endif
+ #ifdef WORLD_STREAMING
+  unsigned long frameStart = micros();
+ #endif
 
-  arduboy.pollButtons();
-  if ((arduboy.justPressed(A_BUTTON) && ballsVisible < MAX_BALLS)) ballsVisible++; // Pressing A button increases the number of visible balls until the maximum has been reached
-  if ((arduboy.justPressed(B_BUTTON) && ballsVisible > 0)) ballsVisible--;         // Pressing B reduces the number of visible balls until none are visible
-  if (arduboy.pressed(UP_BUTTON) && mapLocation.y > 16) mapLocation.y--;           // Pressing directional buttons will scroll the tilemap
-  if (arduboy.pressed(DOWN_BUTTON) && mapLocation.y < 176) mapLocation.y++; 
-  if (arduboy.pressed(LEFT_BUTTON) && mapLocation.x > 16) mapLocation.x--;
-  if (arduboy.pressed(RIGHT_BUTTON) && mapLocation.x < 112) mapLocation.x++; 
+  if (moving)
+  {
+    arduboy.pollButtons();
+    if ((arduboy.justPressed(A_BUTTON) && ballsVisible < MAX_BALLS)) ballsVisible++; // Pressing A button increases the number of visible balls until the maximum has been reached
+    if ((arduboy.justPressed(B_BUTTON) && ballsVisible > 0)) ballsVisible--;         // Pressing B reduces the number of visible balls until none are visible
+    if (arduboy.pressed(UP_BUTTON) && mapLocation.y > 16) mapLocation.y--;           // Pressing directional buttons will scroll the tilemap
+    if (arduboy.pressed(DOWN_BUTTON) && mapLocation.y < 176) mapLocation.y++; 
+    if (arduboy.pressed(LEFT_BUTTON) && mapLocation.x > 16) mapLocation.x--;
+    if (arduboy.pressed(RIGHT_BUTTON) && mapLocation.x < 112) mapLocation.x++; 
+  }
   
-  camera.x = mapLocation.x + circlePoints[pos].x; // circle around a fixed point
-  camera.y = mapLocation.y + circlePoints[pos].y;
+  camera.x = mapLocation.x + (int16_t)pgm_read_word(&circlePoints[pos].x); // circle around a fixed point
+  camera.y = mapLocation.y + (int16_t)pgm_read_word(&circlePoints[pos].y);
   
+ #ifdef INCREMENTAL_SCROLL
+  //only the tiles exposed by the camera movement are read from flash
+  scroller.draw(camera.x, camera.y);
+  memcpy(arduboy.sBuffer, backgroundBuffer, sizeof(backgroundBuffer));
+ #elif defined(DIRTY_RECTS)
+  //only the areas covered by the balls in the previous frame are read from flash
+  backdrop.restore();
+ #else
+ #ifdef WORLD_STREAMING
+  world.update(camera.x, camera.y); // make visible chunks resident
+ #endif
   //draw tilemap
   for (int8_t y = 0; y < VISABLE_TILES_PER_COLUMN; y++)
   {
+   #ifdef WORLD_STREAMING
+    for (uint8_t x = 0; x < VISABLE_TILES_PER_ROW; x++)
+      tilemapBuffer[x] = world.getTile(x + camera.x / tileWidth, y + camera.y / tileHeight);
+   #else
     Cart::readDataArray(tilemap,                   // read the visible tiles on a row from the tilemap in external flash
                         y + camera.y / tileHeight, // the tilemap row
                         camera.x / tileWidth,      // the column within tilemap row
                         tilemapWidth,              // use the width of tilemap as array element size
                         tilemapBuffer,             // reading tiles into a small buffer is faster then reading each tile individually
                         VISABLE_TILES_PER_ROW);
+   #endif
 
     for (uint8_t x = 0; x < VISABLE_TILES_PER_ROW; x++)
     {
       Cart::drawBitmap(x * tileWidth - camera.x % tileWidth,   // we're substracting the tile width and height modulus for scrolling effect
                        y * tileHeight - camera.y % tileHeight, //
-                       gfx1,                                   // the tilesheet bitmap offset in external flash
+                       tileSprites,                            // the tilesheet bitmap in external flash
                        tilemapBuffer[x],                       // tile index
                        dbmNormal);                             // draw a row of normal tiles
     }
   }
-  if (arduboy.notPressed(UP_BUTTON | DOWN_BUTTON | LEFT_BUTTON | RIGHT_BUTTON)) pos = ++pos % CIRCLE_POINTS; //only circle around when no directional buttons are pressed
+ #endif
+  if (moving && arduboy.notPressed(UP_BUTTON | DOWN_BUTTON | LEFT_BUTTON | RIGHT_BUTTON)) pos = ++pos % CIRCLE_POINTS; //only circle around when no directional buttons are pressed
   
   //draw balls
+ #ifdef HUD_LAYER
+  Cart::drawTarget(hud, WIDTH - hud.width, 0);         // a single copy instead of drawing the balls from flash every frame
+ #endif
+ #if defined(FLIP_TEST) || defined(SPRITE_CACHE) || defined(MUSIC)
+  unsigned long drawStart = micros();
+ #endif
+ #ifdef COLLISION_TEST
+  uint8_t collisions = 0;
+  unsigned long collisionTime = 0;
+ #endif
   for (uint8_t i=0; i < ballsVisible; i++)
+  {
+    uint8_t mode = dbmMasked /* | dbmReverse */; // remove the '/*' and '/*' to reverse the balls into white balls
+   #ifdef COLLISION_TEST
+    unsigned long start = micros();
+    if (i && Cart::collide(gfx2, 0, ball[0].point.x, ball[0].point.y, // balls touching the first ball are drawn reversed
+                           gfx2, 0, ball[i].point.x, ball[i].point.y))
+    {
+      mode ^= dbmReverse;
+      collisions++;
+    }
+    collisionTime += micros() - start;
+   #endif
+   #ifdef FLIP_TEST
+    if (ball[i].xspeed < 0) mode |= dbmFlipX;         // balls moving left are mirrored horizontally
+    if (ball[i].yspeed < 0) mode |= dbmFlipY;         // balls moving up are mirrored vertically
+   #endif
+   #ifdef SPRITE_CACHE
+    spriteCache.draw(ball[i].point.x, ball[i].point.y, gfx2, 0, mode); // only the first draw reads from flash
+   #elif defined(DIRTY_RECTS)
+    backdrop.drawBitmap(ball[i].point.x, ball[i].point.y, ballSprite, 0, mode); // also records the area for the next restore
+   #elif defined(GRAYSCALE)
+    gray.drawBitmap(ball[i].point.x, ball[i].point.y, grayBallSprite, 0, mode); // draws the plane of the gray ball shown next
+   #else
     Cart::drawBitmap(ball[i].point.x,                // although the function is called drawBitmap it can also draw masked sprites
                      ball[i].point.y, 
-                     gfx2,                           // the ball sprites masked bitmap offset in external flash memory
+                     ballSprite,                     // the ball sprites masked bitmap in external flash memory
                      0,                              // currently there's only a single sprite frame
-                     dbmMasked /* | dbmReverse */ ); // remove the '/*' and '/*' to reverse the balls into white balls
+                     mode);
+   #endif
+  }
+ #if defined(FLIP_TEST) || defined(SPRITE_CACHE) || defined(MUSIC)
+  unsigned long drawTime = micros() - drawStart;
+  arduboy.setCursor(0,0);                            // compare with FLIP_TEST and SPRITE_CACHE undefined for streamed unmirrored draws
+  arduboy.print(drawTime);
+  arduboy.print(F("us"));
+ #endif
+ #ifdef SPRITE_CACHE
+  arduboy.print(F(" "));                             // draws from the RAM copy and draws that read from flash
+  arduboy.print(spriteCache.hits);
+  arduboy.print(F("/"));
+  arduboy.print(spriteCache.misses);
+ #endif
+ #ifdef MUSIC
+  uint8_t oldSREG = SREG;                            // copy the 16-bit counters the music interrupt updates
+  cli();
+  uint16_t cycles = musicCycles;
+  uint16_t refills = music.refills;
+  uint16_t busyRefills = music.busyRefills;
+  SREG = oldSREG;
+  arduboy.setCursor(0,8);                            // longest interrupt in cycles, refills and refills postponed while the bus was busy
+  arduboy.print(cycles);
+  arduboy.print(F(" "));
+  arduboy.print(refills);
+  arduboy.print(F(" "));
+  arduboy.print(busyRefills);
+ #endif
+ #ifdef OVERLAY_TEST
+  if (overlayReady && arduboy.everyXFrames(FRAME_RATE * 2)) // swap modules. Pages that already hold the module are skipped
+  {
+    uint16_t start = TCNT1;
+    if (overlay.load(overlay.loaded == overlayModule1 ? overlayModule2 : overlayModule1))
+      overlayLoadTime = (uint32_t)(uint16_t)(TCNT1 - start) * (256000000UL / F_CPU); // 16us per count at 16MHz
+  }
+  arduboy.setCursor(0,16);                           // last load time, flash pages programmed (wear) and pages skipped
+  if (overlayReady)
+  {
+    arduboy.print(overlayLoadTime);
+    arduboy.print(F("us "));
+    arduboy.print(overlay.pagesWritten);
+    arduboy.print(F(" "));
+    arduboy.print(overlay.pagesSkipped);
+  }
+  else arduboy.print(F("no overlay"));                // region not aligned or bootloader without FlashPage vector
+ #endif
+ #ifdef GRAYSCALE
+  if (millis() - rateStart >= 1000)                  // planes shown per second and planes started late
+  {
+    rateStart += 1000;
+    planeRate = gray.planes;
+    gray.planes = 0;
+  }
+  arduboy.setCursor(0,0);
+  arduboy.print(planeRate);
+  arduboy.print(F(" "));
+  arduboy.print(gray.latePlanes);
+ #endif
+ #ifdef COLLISION_TEST
+  arduboy.setCursor(0,0);                            // show number of collisions and time used by collision checks
+  arduboy.print(collisions);
+  arduboy.print(F(" "));
+  arduboy.print(collisionTime);
+  arduboy.print(F("us"));
+ #endif
+ #ifdef WORLD_STREAMING
+  uint8_t bucket = (micros() - frameStart) >> 10;      // add frame time to histogram
+  if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+  histogram[bucket]++;
+  uint16_t maxCount = 1;
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) if (histogram[i] > maxCount) maxCount = histogram[i];
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++)      // draw histogram bars scaled to 16 pixels high
+  {
+    uint8_t h = (uint32_t)histogram[i] * 16 / maxCount;
+    if (histogram[i] && !h) h = 1;                     // rare frame times remain visible
+    arduboy.fillRect(i * 3, HEIGHT - 16, 2, 16, BLACK);
+    arduboy.fillRect(i * 3, HEIGHT - h, 2, h, WHITE);
+  }
+  arduboy.setCursor(50, HEIGHT - 8);                   // rows that could not be prefetched in time, most in one frame
+  arduboy.print(world.forcedRows);                     // and rows left to tile reads because of the forced row budget
+  arduboy.print(F(" "));
+  arduboy.print(world.maxForcedRows);
+  arduboy.print(F(" "));
+  arduboy.print(world.deferredRows);
+ #endif
+ #ifdef CART_BUS_COUNTERS
+  arduboy.setCursor(WIDTH - 48, HEIGHT - 8);           // read commands sent and seeks that continued an open read this frame
+  arduboy.print(Cart::busReadCommands);                // each elided seek saves 4 command bytes minus Cart::busGapBytes skipped
+  arduboy.print(F(" "));
+  arduboy.print(Cart::busElidedSeeks);
+  Cart::busReadCommands = 0;
+  Cart::busElidedSeeks  = 0;
+  Cart::busGapBytes     = 0;
+ #endif
                      
   //update ball movements
-  for (uint8_t i=0; i < ballsVisible; i++)
+  if (moving) for (uint8_t i=0; i < ballsVisible; i++)
   {
     if (ball[i].xspeed > 0) // Moving right
     {
@@ -165,8 +437,15 @@ void loop() {
     }
   }
       
-  Cart::enableOLED();// only enable OLED for updating the display
-  arduboy.display(CLEAR_BUFFER);
-  Cart::disableOLED();// disable so flash cart can be used at any time
+ #ifdef DIRTY_RECTS
+  Cart::display();  // keep the buffer, the next restore only repairs the areas drawn over
+ #elif defined(GRAYSCALE)
+  gray.display();   // sends the plane and clears the buffer for the next plane
+ #else
+  Cart::display(CLEAR_BUFFER); // owns the bus for the whole transfer, OLED is disabled again afterwards
+ #endif
+ #ifdef WORLD_STREAMING
+  world.prefetch(); // read a few rows of the next chunks in the time nextFrame() would otherwise idle
+ #endif
 }
 
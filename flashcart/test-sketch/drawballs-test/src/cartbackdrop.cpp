@@ -0,0 +1,106 @@
+#include "cartbackdrop.h"
+
+void CartBackdrop::begin(uint24_t address)
+{
+  this->address = address;
+  count = 0;
+  add(0, WIDTH - 1, 0, HEIGHT / 8 - 1);
+}
+
+
+void CartBackdrop::mark(int16_t x, int16_t y, int16_t width, int16_t height)
+{
+  // clip to the screen
+  if (x < 0)
+  {
+    width += x;
+    x = 0;
+  }
+  if (y < 0)
+  {
+    height += y;
+    y = 0;
+  }
+  if (x + width > WIDTH) width = WIDTH - x;
+  if (y + height > HEIGHT) height = HEIGHT - y;
+  if ((width <= 0) || (height <= 0)) return;
+  add(x, x + width - 1, y >> 3, (y + height - 1) >> 3);
+}
+
+
+void CartBackdrop::drawBitmap(int16_t x, int16_t y, const CartSprite& sprite, uint16_t frame, uint8_t mode)
+{
+  mark(x, y, sprite.width, sprite.height);
+  Cart::drawBitmap(x, y, sprite, frame, mode);
+}
+
+
+void CartBackdrop::add(uint8_t left, uint8_t right, uint8_t top, uint8_t bottom)
+{
+  CartBackdropRect* rect = rects + count;
+  if (count == CART_BACKDROP_RECTS)
+  {
+    // list is full: merge with the region that grows least
+    uint16_t least = 0xFFFF;
+    for (CartBackdropRect* r = rects; r < rects + CART_BACKDROP_RECTS; r++)
+    {
+      uint8_t l = min(left, r->left);
+      uint8_t t = min(top, r->top);
+      uint16_t grow = Cart::multiplyUInt8(max(right, r->right) - l + 1, max(bottom, r->bottom) - t + 1) -
+                      Cart::multiplyUInt8(r->right - r->left + 1, r->bottom - r->top + 1);
+      if (grow < least)
+      {
+        least = grow;
+        rect  = r;
+      }
+    }
+    left   = min(left, rect->left);
+    right  = max(right, rect->right);
+    top    = min(top, rect->top);
+    bottom = max(bottom, rect->bottom);
+  }
+  else count++;
+  rect->left   = left;
+  rect->right  = right;
+  rect->top    = top;
+  rect->bottom = bottom;
+}
+
+
+void CartBackdrop::restore()
+{
+  bytesRestored = 0;
+  for (uint8_t page = 0; page < HEIGHT / 8; page++)
+  {
+    // spans of the regions on this page row sorted by left column
+    uint8_t lefts[CART_BACKDROP_RECTS];
+    uint8_t rights[CART_BACKDROP_RECTS];
+    uint8_t spans = 0;
+    for (CartBackdropRect* rect = rects; rect < rects + count; rect++)
+    {
+      if ((page < rect->top) || (page > rect->bottom)) continue;
+      uint8_t i = spans++;
+      for (; i && (lefts[i - 1] > rect->left); i--)
+      {
+        lefts[i]  = lefts[i - 1];
+        rights[i] = rights[i - 1];
+      }
+      lefts[i]  = rect->left;
+      rights[i] = rect->right;
+    }
+    // overlapping spans are read once. Spans a few bytes apart continue the
+    // same flash read (see Cart::seekRead)
+    uint16_t offset = page * WIDTH;
+    for (uint8_t i = 0; i < spans;)
+    {
+      uint8_t left  = lefts[i];
+      uint8_t right = rights[i];
+      for (i++; (i < spans) && (lefts[i] <= right + 1); i++)
+        if (rights[i] > right) right = rights[i];
+      uint8_t length = right - left + 1;
+      Cart::readDataBytes(address + offset + left, Arduboy2Base::sBuffer + offset + left, length);
+      bytesRestored += length;
+    }
+  }
+  count = 0;
+}
@@ -0,0 +1,52 @@
+#include "cartgray.h"
+
+constexpr uint8_t OLED_SET_MULTIPLEX = 0xA8;
+constexpr uint8_t OLED_SET_CLOCK     = 0xD5;
+constexpr uint8_t OLED_SET_PRECHARGE = 0xD9;
+
+void CartGray::begin(uint16_t planeTime)
+{
+  this->planeTime = planeTime;
+  Cart::enableOLED();
+  Arduboy2Base::sendLCDCommand(OLED_SET_CLOCK);
+  Arduboy2Base::sendLCDCommand(CART_GRAY_DISPLAY_CLOCK);
+  Arduboy2Base::sendLCDCommand(OLED_SET_PRECHARGE);
+  Arduboy2Base::sendLCDCommand(CART_GRAY_PRECHARGE);
+  Cart::disableOLED();
+  subframe = CART_GRAY_SUBFRAMES - 1; // first plane shown is plane 0
+  planeStart = micros() - planeTime;
+}
+
+
+bool CartGray::nextPlane()
+{
+  uint16_t elapsed = (uint16_t)micros() - planeStart;
+  if (elapsed < planeTime) return false;
+  if (elapsed < 2 * planeTime) planeStart += planeTime; // keep the pace
+  else
+  {
+    planeStart += elapsed;                               // too late to catch up, start over from now
+    latePlanes++;
+  }
+  if (++subframe == CART_GRAY_SUBFRAMES) subframe = 0;
+  return true;
+}
+
+
+void CartGray::display()
+{
+  Cart::enableOLED();
+  if (parkScan)
+  {
+    Arduboy2Base::sendLCDCommand(OLED_SET_MULTIPLEX); // park the scan while the plane is sent
+    Arduboy2Base::sendLCDCommand(CART_GRAY_PARK_MUX);
+  }
+  Arduboy2Base::paintScreen(Arduboy2Base::sBuffer, true);
+  if (parkScan)
+  {
+    Arduboy2Base::sendLCDCommand(OLED_SET_MULTIPLEX); // full scan again with the new plane
+    Arduboy2Base::sendLCDCommand(HEIGHT - 1);
+  }
+  Cart::disableOLED();
+  planes++;
+}
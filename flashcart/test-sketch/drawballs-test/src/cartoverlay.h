@@ -0,0 +1,51 @@
+#ifndef CART_OVERLAY_H
+#define CART_OVERLAY_H
+
+#include "cart.h"
+
+constexpr uint8_t  CART_OVERLAY_PAGE_SIZE   = 128;    // internal flash (SPM) page size
+constexpr uint8_t  CART_OVERLAY_HEADER_SIZE = 4;      // load address, size (16-bit big endian, created by overlay-converter.py)
+constexpr uint16_t CART_OVERLAY_VECTOR      = 0x7FFC; // FlashPage vector of Cathy bootloaders
+constexpr uint16_t CART_BOOT_SIGNATURE      = 0xDCFB; // stored after the FlashPage vector
+constexpr uint16_t CART_OVERLAY_FLASH_END   = 0x7000; // region must end below the largest (4K) boot section
+
+// Loads code modules stored in the program data area into a region of internal
+// flash that is reserved by the sketch. Pages are programmed through the
+// bootloader FlashPage vector and pages that already contain the module code
+// are not programmed again so reloading a module does not wear the flash.
+//
+// The region is a PROGMEM array aligned to CART_OVERLAY_PAGE_SIZE. begin()
+// refuses a region that is not aligned, because programming its first page
+// would erase the sketch code that shares the page. A module is linked at the
+// address of the region and starts with a table of jmp instructions to its
+// entry points, called using call(index).
+//
+// Programming a page (erase and write) takes about 8ms with interrupts disabled,
+// so millis() and micros() fall behind while a module is loaded. Comparing a
+// page that does not need programming takes well under a millisecond. The
+// OVERLAY_TEST option of drawballs-test shows the load time measured with a
+// hardware timer.
+
+class CartOverlay
+{
+  public:
+    bool begin(const uint8_t* region, uint16_t size); // returns false when the region is not page aligned or reaches the boot section, or the bootloader has no FlashPage vector
+
+    bool load(uint24_t module); // copies a module into the region. Returns false when the module is not linked for the region or begin failed
+
+    void call(uint8_t index) // calls an entry point of the loaded module
+    {
+      if (valid) ((void (*)())((uintptr_t)(region + (index << 2)) >> 1))();
+    }
+
+    uint24_t loaded;          // program data address of loaded module
+    uint16_t pagesWritten;    // flash pages erased and programmed (wear)
+    uint16_t pagesSkipped;    // flash pages that already contained the module code
+
+  private:
+    const uint8_t* region;
+    uint16_t size;
+    bool     valid;           // region contains a complete module
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CART_PCM_H
+#define CART_PCM_H
+
+#include "cart.h"
+
+constexpr uint16_t CART_PCM_BUFFER_SIZE = 256;  // ring buffer size, the uint8_t ring positions wrap by themselves
+constexpr uint8_t  CART_PCM_MIN_FILL    = 32;   // smallest flash read done by fill (each read costs a seek)
+constexpr uint8_t  CART_PCM_SILENCE     = 0x80; // sample value played after the end of a sound
+
+// Plays 8-bit unsigned PCM sound (created by pcm-converter.py) streamed from
+// the program data area at 8 to 16 kHz. Timer 4 runs 8-bit fast PWM at
+// 62.5 kHz on both speaker pins (OC4A and its complement) and timer 1
+// interrupts at the sample rate. The sketch defines the interrupt handler:
+//
+// ISR(TIMER1_COMPA_vect) { pcm.tick(); }
+//
+// tick() only copies the next sample from the ring buffer to the PWM compare
+// register. The ring buffer is refilled from flash by fill() in the main loop
+// so the interrupt never uses the bus. 256 samples last 16 ms at 16 kHz so
+// fill() must be called at least that often, it is cheap to call when the
+// buffer is still full.
+//
+// position() counts the samples played and is the clock for video sync: show
+// frame position() * fps / rate. After the end of the sound silence is
+// played and position() keeps counting. When the buffer runs empty the clock
+// stops too, so video and sound stay in sync over any length.
+//
+// CPU budget (estimated cycles, not measured): tick() about 60 cycles per
+// sample (6% of the CPU at 16 kHz, 3% at 8 kHz). fill() about 20 cycles per
+// sample plus a seek per read (2% at 16 kHz). That leaves about 92% of the
+// CPU at 16 kHz for rendering. Sound is muted by arduboy.audio.off() as usual.
+
+class CartPcm
+{
+  public:
+    void begin(uint16_t rate); // sets up the PWM and sample rate timers
+
+    void play(uint24_t address, uint24_t length); // starts a sound of length samples in the program data area
+
+    void stop(); // stops the sample interrupt and releases the speaker pins
+
+    bool playing() { return active && samplesRead < length; } // true until all samples are read from flash
+
+    void fill(); // tops up the ring buffer from flash, call from the main loop
+
+    uint24_t position() { return samplesRead - (uint8_t)(head - tail); } // samples played since play
+
+    inline void tick() // call from the timer 1 compare interrupt
+    {
+      uint8_t t = tail;
+      if (t == head) return; // buffer empty, hold the last sample
+      OCR4A = buffer[t];
+      tail = t + 1;
+    }
+
+    uint16_t underruns; // fills that found the buffer empty
+
+  private:
+    uint8_t  buffer[CART_PCM_BUFFER_SIZE];
+    uint24_t sound;          // first sample
+    uint24_t length;         // samples in sound
+    uint24_t samplesRead;    // samples put in the buffer (silence after the end included)
+    volatile uint8_t head;   // next sample written by fill
+    volatile uint8_t tail;   // next sample played by tick
+    bool     active;
+};
+
+#endif
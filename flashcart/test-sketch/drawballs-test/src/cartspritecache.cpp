@@ -0,0 +1,187 @@
+#include "cartspritecache.h"
+
+void CartSpriteCache::begin(uint8_t* arena, uint16_t size)
+{
+  this->arena = arena;
+  this->size  = size;
+  clear();
+}
+
+
+void CartSpriteCache::clear()
+{
+  for (uint8_t i = 0; i < CART_SPRITE_CACHE_ENTRIES; i++) entries[i].size = 0;
+  bytesUsed = 0;
+}
+
+
+void CartSpriteCache::draw(int16_t x, int16_t y, uint24_t address, uint16_t frame, uint8_t mode)
+{
+  if (mode & (dbmFlipX | dbmFlipY))
+  {
+    Cart::drawBitmap(x, y, address, frame, mode);
+    return;
+  }
+  uint8_t masked = mode & dbmMasked;
+  CartSpriteCacheEntry* entry = find(address, frame, masked);
+  if (entry == NULL)
+  {
+    misses++;
+    entry = insert(address, frame, masked);
+    if (entry == NULL) // does not fit in arena
+    {
+      Cart::drawBitmap(x, y, address, frame, mode);
+      return;
+    }
+  }
+  else hits++;
+  entry->used = ++tick;
+  drawData(x, y, arena + entry->offset, entry->width, entry->height, mode);
+}
+
+
+CartSpriteCacheEntry* CartSpriteCache::find(uint24_t address, uint16_t frame, uint8_t masked)
+{
+  for (CartSpriteCacheEntry* entry = entries; entry < entries + CART_SPRITE_CACHE_ENTRIES; entry++)
+    if (entry->size && (entry->address == address) && (entry->frame == frame) && (entry->masked == masked)) return entry;
+  return NULL;
+}
+
+
+CartSpriteCacheEntry* CartSpriteCache::insert(uint24_t address, uint16_t frame, uint8_t masked)
+{
+  // read bitmap dimensions from flash
+  Cart::seekData(address);
+  uint16_t width  = Cart::readPendingUInt16();
+  uint16_t height = Cart::readPendingLastUInt16();
+  if ((width > 0xFF) || (height > 0xFF)) return NULL;
+  uint8_t rows = (height + 7) >> 3;
+  uint16_t bytes = Cart::multiplyUInt8(rows, width);
+  if (masked) bytes += bytes;
+  if (bytes > size) return NULL;
+
+  // evict least recently used frames until both a free entry and enough bytes are available
+  CartSpriteCacheEntry* free;
+  for (;;)
+  {
+    free = NULL;
+    CartSpriteCacheEntry* oldest = NULL;
+    uint16_t age = 0;
+    for (CartSpriteCacheEntry* entry = entries; entry < entries + CART_SPRITE_CACHE_ENTRIES; entry++)
+    {
+      if (entry->size == 0) free = entry;
+      else if ((uint16_t)(tick - entry->used) >= age)
+      {
+        age = tick - entry->used;
+        oldest = entry;
+      }
+    }
+    if (free && (bytesUsed + bytes <= size)) break;
+    evict(oldest);
+  }
+  compact();
+  free->address = address;
+  free->frame   = frame;
+  free->offset  = bytesUsed;
+  free->size    = bytes;
+  free->width   = width;
+  free->height  = height;
+  free->masked  = masked;
+  bytesUsed += bytes;
+  Cart::readDataBytes(address + 4 + (uint24_t)frame * bytes, arena + free->offset, bytes);
+  return free;
+}
+
+
+void CartSpriteCache::evict(CartSpriteCacheEntry* entry)
+{
+  bytesUsed -= entry->size;
+  entry->size = 0;
+  evictions++;
+}
+
+
+void CartSpriteCache::compact()
+{
+  // move cached frames to the start of the arena in arena order so free bytes are at the end
+  uint16_t offset = 0;
+  for (;;)
+  {
+    CartSpriteCacheEntry* next = NULL;
+    for (CartSpriteCacheEntry* entry = entries; entry < entries + CART_SPRITE_CACHE_ENTRIES; entry++)
+      if (entry->size && (entry->offset >= offset) && ((next == NULL) || (entry->offset < next->offset))) next = entry;
+    if (next == NULL) return;
+    if (next->offset != offset) memmove(arena + offset, arena + next->offset, next->size);
+    next->offset = offset;
+    offset += next->size;
+  }
+}
+
+
+void CartSpriteCache::drawData(int16_t x, int16_t y, const uint8_t* data, uint8_t width, uint8_t height, uint8_t mode)
+{
+  // return if the bitmap is completely off target
+  const uint8_t targetwidth = Cart::target.width;
+  const int16_t targetheight = Cart::target.pages << 3;
+  if (x + width <= 0 || x >= targetwidth || y + height <= 0 || y >= targetheight) return;
+
+  // determine visible columns
+  int16_t skipleft = x < 0 ? -x : 0;
+  uint8_t renderwidth = (x + width > targetwidth ? targetwidth - x : width) - skipleft;
+  uint8_t step = mode & dbmMasked ? 2 : 1; // bytes per column
+  uint16_t rowsize = Cart::multiplyUInt8(width, step);
+  data += Cart::multiplyUInt8(skipleft, step);
+
+  uint8_t rows = (height + 7) >> 3;
+  uint8_t lastmask = Cart::bitShiftRightMaskUInt8(-height); // used pixels in last page row
+  uint8_t yshift = Cart::bitShiftLeftUInt8(y); //shift by multiply
+  for (uint8_t row = 0; row < rows; row++, data += rowsize)
+  {
+    int16_t top = y + (row << 3);
+    if (top <= -8) continue;
+    if (top >= targetheight) break;
+    uint8_t rowmask = row == rows - 1 ? lastmask : 0xFF;
+    int8_t displayrow = top >> 3;
+    bool extrarow = (yshift != 1) && (displayrow < Cart::target.pages - 1);
+    uint8_t* display = Cart::target.buffer + displayrow * targetwidth + x + skipleft;
+    const uint8_t* src = data;
+    if ((mode == dbmMasked) && (displayrow >= 0) && extrarow) // most common sprite case without mode tests
+    {
+      for (uint8_t c = renderwidth; c; c--)
+      {
+        uint16_t bitmap = Cart::multiplyUInt8(*src++, yshift);
+        uint16_t mask = Cart::multiplyUInt8(*src++, yshift);
+        uint8_t pixels = display[0];
+        display[0] = pixels ^ ((pixels ^ (uint8_t)bitmap) & (uint8_t)mask);
+        pixels = display[targetwidth];
+        display[targetwidth] = pixels ^ ((pixels ^ (uint8_t)(bitmap >> 8)) & (uint8_t)(mask >> 8));
+        display++;
+      }
+      continue;
+    }
+    for (uint8_t c = renderwidth; c; c--)
+    {
+      uint8_t bitmapbyte = *src++;
+      uint8_t maskbyte = rowmask;
+      if (mode & dbmMasked) maskbyte = *src++;
+      if (mode & _BV(dbfReverseBlack)) bitmapbyte ^= 0xFF;
+      if (mode & _BV(dbfWhiteBlack)) maskbyte = bitmapbyte & rowmask;
+      if (mode & _BV(dbfBlack)) bitmapbyte = 0;
+      uint16_t bitmap = Cart::multiplyUInt8(bitmapbyte, yshift);
+      uint16_t mask = Cart::multiplyUInt8(maskbyte, yshift);
+      if (displayrow >= 0)
+      {
+        uint8_t pixels = bitmap;
+        if ((mode & _BV(dbfInvert)) == 0) pixels ^= display[0];
+        display[0] ^= pixels & mask;
+      }
+      if (extrarow)
+      {
+        uint8_t pixels = bitmap >> 8;
+        if ((mode & _BV(dbfInvert)) == 0) pixels ^= display[targetwidth];
+        display[targetwidth] ^= pixels & (mask >> 8);
+      }
+      display++;
+    }
+  }
+}
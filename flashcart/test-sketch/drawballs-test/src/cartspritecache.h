@@ -0,0 +1,53 @@
+#ifndef CART_SPRITE_CACHE_H
+#define CART_SPRITE_CACHE_H
+
+#include "cart.h"
+
+constexpr uint8_t CART_SPRITE_CACHE_ENTRIES = 8; // maximum number of cached frames
+
+struct CartSpriteCacheEntry
+{
+  uint24_t address; // bitmap offset in program data area
+  uint16_t frame;
+  uint16_t offset;  // frame data location in arena
+  uint16_t size;    // frame data size in bytes (0 for unused entry)
+  uint8_t  width;
+  uint8_t  height;
+  uint8_t  masked;  // frame data contains mask bytes
+  uint16_t used;    // tick of last use
+};
+
+// Keeps recently drawn bitmap frames in a RAM arena provided by the sketch and
+// draws them from RAM with the same modes as Cart::drawBitmap. Bitmaps are
+// cached per frame (header included) and the least recently used frames are
+// evicted when the arena or the entry table is full. Frames larger than the
+// arena and mirrored draws are streamed from flash as usual.
+
+class CartSpriteCache
+{
+  public:
+    void begin(uint8_t* arena, uint16_t size);
+
+    void draw(int16_t x, int16_t y, uint24_t address, uint16_t frame, uint8_t mode); // same as Cart::drawBitmap
+
+    void clear(); // forget all cached frames (when flash data was changed)
+
+    uint16_t hits;      // draws from RAM
+    uint16_t misses;    // draws that read from flash
+    uint16_t evictions; // frames removed to make room
+    uint16_t bytesUsed; // arena bytes used by cached frames
+
+  private:
+    CartSpriteCacheEntry* find(uint24_t address, uint16_t frame, uint8_t masked);
+    CartSpriteCacheEntry* insert(uint24_t address, uint16_t frame, uint8_t masked);
+    void evict(CartSpriteCacheEntry* entry);
+    void compact();
+    void drawData(int16_t x, int16_t y, const uint8_t* data, uint8_t width, uint8_t height, uint8_t mode);
+
+    CartSpriteCacheEntry entries[CART_SPRITE_CACHE_ENTRIES];
+    uint8_t* arena;
+    uint16_t size;
+    uint16_t tick;
+};
+
+#endif
@@ -28,14 +28,30 @@
 #define ANIMATION_FRAMES 1454      /* number of 1K images in bin file  */
 #define ANIMATION_FPS 15
 
+//#define DIRECT_DISPLAY     // stream frames from flash directly to the display instead of copying them to the display buffer first
+
+//#define ANIMATION_SOUND            /* play 8-bit PCM sound (pcm-converter.py) appended to the frames bin file */
+#define ANIMATION_SOUND_RATE 16000   /* sample rate given to pcm-converter.py */
+#define ANIMATION_SOUND_SAMPLES 0    /* number of samples given by pcm-converter.py */
+
 #include <Arduboy2.h>
 #include "src/cart.h"
+#include "src/cartpcm.h"
 
 Arduboy2 arduboy;
 uint8_t  state;
 JedecID  jedecID;
 uint16_t frames;
 
+#ifdef ANIMATION_SOUND
+CartPcm pcm;
+
+ISR(TIMER1_COMPA_vect)
+{
+  pcm.tick();
+}
+#endif
+
 void printHexByte(uint8_t b)
 {
  if (b <16) arduboy.print(0);
@@ -78,8 +94,24 @@ void showJedecID()
 
 void showFrames()
 {
+ #ifdef ANIMATION_SOUND
+  // the sound sets the pace: wait for the frame that is due and skip frames when running late
+  uint16_t due;
+  while ((due = (uint32_t)pcm.position() * ANIMATION_FPS / ANIMATION_SOUND_RATE) < frames) pcm.fill();
+  if (due >= ANIMATION_FRAMES)
+  {
+    due = 0;
+    pcm.play((uint24_t)ANIMATION_FRAMES * 1024, ANIMATION_SOUND_SAMPLES); // start over together
+  }
+  frames = due;
+ #endif
+ #ifdef DIRECT_DISPLAY
+  //sends 1K images from flash to display using a small buffer
+  Cart::displayFrame((uint24_t)frames * 1024);
+ #else
   //loads 1K images from flash to display buffer  
   Cart::readDataBytes((uint24_t)frames * 1024, arduboy.sBuffer, 1024);
+ #endif
   if (++frames == ANIMATION_FRAMES) frames = 0; //number of frames in animation
 }
 
@@ -101,28 +133,41 @@ void setup() {
   Cart::disableOLED(); //OLED must be disabled before cart can be used. OLED display should only be enabled prior updating the display.
   Cart::begin(ANIMATION_DATA_PAGE);  //cart may be in power down mode so wake it up (Cathy bootloader puts cart into powerdown mode)
                                      //and set the program data flash page for development / uploading through Arduino IDE
+ #ifdef ANIMATION_SOUND
+  pcm.begin(ANIMATION_SOUND_RATE);
+ #endif
 }
 
 
 void loop() {
+ #ifdef ANIMATION_SOUND
+  pcm.fill(); // keep the sample buffer topped up while waiting for the next frame
+ #endif
   if (!arduboy.nextFrame()) return;
 
   arduboy.pollButtons();
   if (arduboy.justPressed(A_BUTTON))
   {
     state = 1;
+   #ifdef ANIMATION_SOUND
+    pcm.stop();
+   #endif
   }
   if (arduboy.justPressed(B_BUTTON))
   { 
     state  = 2; 
     frames = 0;
+   #ifdef ANIMATION_SOUND
+    pcm.play((uint24_t)ANIMATION_FRAMES * 1024, ANIMATION_SOUND_SAMPLES); // sound follows the last frame
+   #endif
   }
   switch (state)
   {
 	  case 1 : showJedecID(); break;
 	  case 2 : showFrames(); break;
   }
-  Cart::enableOLED();// only enable OLED prior using display
-  arduboy.display();
-  Cart::disableOLED();// disable so flash cart can be used
+ #ifdef DIRECT_DISPLAY
+  if (state == 2) return; // frame is already on display
+ #endif
+  Cart::display(); // enables OLED only while the display is updated
 }
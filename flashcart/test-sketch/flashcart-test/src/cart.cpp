@@ -4,6 +4,39 @@
 uint16_t Cart::programDataPage; // program read only data location in flash memory
 uint16_t Cart::programSavePage; // program read and write data location in flash memory
 
+CartTarget Cart::target = {Arduboy2Base::sBuffer, WIDTH, HEIGHT / 8};
+
+uint8_t Cart::readCommand = SFC_READ;
+uint8_t Cart::addressBank;
+
+uint24_t Cart::readAddress;
+bool     Cart::readOpen;
+
+volatile uint8_t Cart::busOwner;
+uint8_t  Cart::suspendedOwner;
+uint24_t Cart::suspendedAddress;
+uint8_t  Cart::suspendedBank;
+
+#ifdef CART_BUS_COUNTERS
+uint16_t Cart::busReadCommands;
+uint16_t Cart::busElidedSeeks;
+uint16_t Cart::busGapBytes;
+#endif
+
+uint16_t Cart::segmentPage;
+uint16_t Cart::segmentPages[CART_SEGMENTS];
+uint8_t  Cart::segmentCount;
+
+uint16_t Cart::directoryBucketMask;
+uint16_t Cart::directorySlotMask;
+CartAssetCacheEntry Cart::assetCache[CART_ASSET_CACHE_SIZE];
+
+CartFont Cart::font;
+uint8_t  Cart::textMode;
+int16_t  Cart::cursorX;
+int16_t  Cart::cursorY;
+int16_t  Cart::cursorLeft;
+
 
 uint8_t Cart::writeByte(uint8_t data)
 {
@@ -25,6 +58,7 @@ uint8_t Cart::readByte()
 void Cart::begin()
 {
   wakeUp();
+  selectAddressMode();
 }
 
 
@@ -38,7 +72,9 @@ void Cart::begin(uint16_t developmentDataPage)
   {
     programDataPage = developmentDataPage;
   }
+  resetDirectory();
   wakeUp();
+  selectAddressMode();
   noCartReboot();
 }
 
@@ -61,7 +97,9 @@ void Cart::begin(uint16_t developmentDataPage, uint16_t developmentSavePage)
   {
     programSavePage = developmentSavePage;
   }
+  resetDirectory();
   wakeUp();
+  selectAddressMode();
   noCartReboot();
 }
 
@@ -115,10 +153,39 @@ void Cart::writeEnable()
 }
 
 
+JedecID Cart::readJedecID()
+{
+  JedecID id;
+  enable();
+  writeByte(SFC_JEDEC_ID);
+  id.manufacturer = readByte();
+  id.device = readByte();
+  id.size = readByte();
+  disable();
+  return id;
+}
+
+
+void Cart::selectAddressMode()
+{
+  uint8_t size = readJedecID().size;
+  if ((size >= CART_JEDEC_SIZE_4BYTE) && (size <= CART_JEDEC_SIZE_MAX)) readCommand = SFC_READ4;
+  else readCommand = SFC_READ;
+}
+
+
 void Cart::seekCommand(uint8_t command, uint24_t address)
 {
   enable();
-  writeByte(command);
+  if (readCommand == SFC_READ4) // flash memory larger than 16MB
+  {
+    if (command == SFC_READ) command = SFC_READ4;
+    else if (command == SFC_WRITE) command = SFC_WRITE4;
+    else if (command == SFC_ERASE) command = SFC_ERASE4;
+    writeByte(command);
+    writeByte(addressBank);
+  }
+  else writeByte(command);
   writeByte(address >> 16);
   writeByte(address >> 8);
   writeByte(address);
@@ -140,8 +207,68 @@ void Cart::seekData(uint24_t address)
  #else // C++ version for non AVR platforms
   address += (uint24_t)programDataPage << 8;
  #endif
-  seekCommand(SFC_READ, address);
+  seekRead(address);
+}
+
+
+void Cart::seekRead(uint24_t address)
+{
+  busOwner = CART_BUS_FLASH; // an interrupt handler may not end an open read while its gap is skipped
+  uint24_t gap = address - readAddress;
+  if (readOpen && (address >= readAddress) && (gap <= CART_READ_GAP))
+  {
+   #ifdef CART_BUS_COUNTERS
+    busElidedSeeks++;
+    busGapBytes += gap;
+   #endif
+    for (; gap; gap--) readByte(); // skip gap
+    readOpen = false;
+  }
+  else
+  {
+   #ifdef CART_BUS_COUNTERS
+    busReadCommands++;
+   #endif
+    seekCommand(SFC_READ, address);
+  }
+  readAddress = address;
   SPDR = 0;
+  busOwner = CART_BUS_STREAM;
+}
+
+
+bool Cart::suspend()
+{
+  uint8_t owner = busOwner;
+  if ((owner == CART_BUS_FLASH) || (owner == CART_BUS_OLED)) return false;
+  suspendedOwner = owner;
+  suspendedAddress = readAddress;
+  suspendedBank = addressBank;
+  if (owner == CART_BUS_STREAM) wait(); // the pending byte is read again after resume
+  disable();
+  return true;
+}
+
+
+void Cart::resume()
+{
+  disable();
+  addressBank = suspendedBank;
+  readAddress = suspendedAddress;
+  if (suspendedOwner == CART_BUS_STREAM)
+  {
+    seekCommand(SFC_READ, readAddress);
+    SPDR = 0;
+    busOwner = CART_BUS_STREAM;
+  }
+}
+
+
+void Cart::display(bool clear)
+{
+  enableOLED();
+  Arduboy2Base::paintScreen(Arduboy2Base::sBuffer, clear);
+  disableOLED();
 }
 
 
@@ -166,12 +293,82 @@ void Cart::seekDataArray(uint24_t address, uint8_t index, uint8_t offset, uint8_
     : "r24"
   );
   #else
-   address += size ? index * size + offset : index * 256 + offset;
+   address += elementSize ? index * elementSize + offset : index * 256 + offset;
   #endif
   seekData(address);
 }   
 
 
+void Cart::seekDataArray16(uint24_t address, uint16_t index, uint8_t offset, uint8_t elementSize)
+{
+ #ifdef ARDUINO_ARCH_AVR
+  asm volatile (
+    "   clr     r24                 \n" //use as alternative zero reg
+    "   tst     %[size]             \n"
+    "   breq    1f                  \n" //treat size 0 as size 256
+    "   mul     %A[index], %[size]  \n"
+    "   add     %A[address], r0     \n"
+    "   adc     %B[address], r1     \n"
+    "   adc     %C[address], r24    \n"
+    "   mul     %B[index], %[size]  \n"
+    "   add     %B[address], r0     \n"
+    "   adc     %C[address], r1     \n"
+    "   rjmp    2f                  \n"
+    "1:                             \n"
+    "   add     %B[address], %A[index] \n"
+    "   adc     %C[address], %B[index] \n"
+    "2:                             \n"
+    "   add     %A[address], %[offset] \n"
+    "   adc     %B[address], r24    \n"
+    "   adc     %C[address], r24    \n"
+    "   clr     r1                  \n"
+    : [address] "+r" (address)
+    : [index]   "r"  (index),
+      [offset]  "r"  (offset),
+      [size]    "r"  (elementSize)
+    : "r24"
+  );
+  #else
+   address += elementSize ? (uint24_t)index * elementSize + offset : (uint24_t)index * 256 + offset;
+  #endif
+  seekData(address);
+}
+
+
+void Cart::seekDataArray2D(uint24_t address, uint16_t row, uint16_t column, uint16_t rowSize)
+{
+ #ifdef ARDUINO_ARCH_AVR
+  asm volatile (
+    "   clr     r24                 \n" //use as alternative zero reg
+    "   mul     %A[row], %A[size]   \n" // address += row * rowSize (24-bit)
+    "   add     %A[address], r0     \n"
+    "   adc     %B[address], r1     \n"
+    "   adc     %C[address], r24    \n"
+    "   mul     %A[row], %B[size]   \n"
+    "   add     %B[address], r0     \n"
+    "   adc     %C[address], r1     \n"
+    "   mul     %B[row], %A[size]   \n"
+    "   add     %B[address], r0     \n"
+    "   adc     %C[address], r1     \n"
+    "   mul     %B[row], %B[size]   \n"
+    "   add     %C[address], r0     \n"
+    "   add     %A[address], %A[column] \n" // address += column
+    "   adc     %B[address], %B[column] \n"
+    "   adc     %C[address], r24    \n"
+    "   clr     r1                  \n"
+    : [address] "+r" (address)
+    : [row]     "r"  (row),
+      [column]  "r"  (column),
+      [size]    "r"  (rowSize)
+    : "r24"
+  );
+  #else
+   address += (uint24_t)row * rowSize + column;
+  #endif
+  seekData(address);
+}
+
+
 void Cart::seekSave(uint24_t address)
 {
  #ifdef ARDUINO_ARCH_AVR
@@ -187,29 +384,93 @@ void Cart::seekSave(uint24_t address)
  #else // C++ version for non AVR platforms
   address += (uint24_t)programSavePage << 8;
  #endif
-  seekCommand(SFC_READ, address);
-  SPDR = 0;
+  seekRead(address);
 }
 
 
-uint8_t Cart::readPendingUInt8()
+void Cart::seekSegment(uint24_t address)
 {
  #ifdef ARDUINO_ARCH_AVR
-  asm volatile("cart_cpp_readPendingUInt8:\n"); // create label for calls in Cart::readPendingUInt16
+  asm volatile( // assembly optimizer for AVR platform
+    "lds  r0, %[page]+0 \n"
+    "add  %B[addr], r0  \n"
+    "lds  r0, %[page]+1 \n"
+    "adc  %C[addr], r0  \n"
+    :[addr] "+&r" (address)
+    :[page] ""    (&segmentPage)
+    :
+  );
+ #else // C++ version for non AVR platforms
+  address += (uint24_t)segmentPage << 8;
  #endif
+  seekRead(address);
+}
+
+
+uint8_t Cart::readPendingUInt8()
+{
+ #ifdef ARDUINO_ARCH_AVR
+  uint8_t result asm("r24");
+  asm volatile
+  ( "cart_cpp_readPendingUInt8:         \n" // create label for calls in Cart::readPendingUInt16 (uses r24 only)
+    "ldi  r24, %[busflash]              \n" // busOwner = CART_BUS_FLASH; the stream position is not tracked
+    "sts  %[busowner], r24              \n" // while the run of pending reads lasts
+    "1:                                 \n"
+    "in   r24, %[spsr]                  \n" // wait()
+    "sbrs r24, %[spif]                  \n"
+    "rjmp 1b                            \n"
+    "in   r24, %[spdr]                  \n"
+    "out  %[spdr], r1                   \n" // SPDR = 0
+    : "=&r" (result)
+    : [busowner] ""  (&busOwner),
+      [busflash] "M" (CART_BUS_FLASH),
+      [spsr]     "I" (_SFR_IO_ADDR(SPSR)),
+      [spif]     "I" (SPIF),
+      [spdr]     "I" (_SFR_IO_ADDR(SPDR))
+    :
+  );
+  return result;
+ #else
+  busOwner = CART_BUS_FLASH; // the stream position is not tracked while the run of pending reads lasts
   wait();
   uint8_t result = SPDR;
   SPDR = 0;
   return result;
+ #endif
 }
 
 
 uint8_t Cart::readPendingLastUInt8()
 {
  #ifdef ARDUINO_ARCH_AVR
-  asm volatile("cart_cpp_readPendingLastUInt8:\n"); // create label for calls in Cart::readPendingUInt16
- #endif
+  uint8_t result asm("r24");
+  asm volatile
+  ( "cart_cpp_readPendingLastUInt8:     \n" // create label for calls in Cart::readPendingLastUInt16 (uses r24 only)
+    "ldi  r24, %[busflash]              \n" // busOwner = CART_BUS_FLASH; no byte is pending after this one
+    "sts  %[busowner], r24              \n"
+    "1:                                 \n"
+    "in   r24, %[spsr]                  \n" // wait()
+    "sbrs r24, %[spif]                  \n"
+    "rjmp 1b                            \n"
+    "in   r24, %[spdr]                  \n"
+    "sbi  %[cartport], %[cartbit]       \n" // disable()
+    "sts  %[readopen], r1               \n" // readOpen = false;
+    "sts  %[busowner], r1               \n" // busOwner = CART_BUS_IDLE;
+    : "=&r" (result)
+    : [busowner] ""  (&busOwner),
+      [busflash] "M" (CART_BUS_FLASH),
+      [readopen] ""  (&readOpen),
+      [cartport] "I" (_SFR_IO_ADDR(CART_PORT)),
+      [cartbit]  "I" (CART_BIT),
+      [spsr]     "I" (_SFR_IO_ADDR(SPSR)),
+      [spif]     "I" (SPIF),
+      [spdr]     "I" (_SFR_IO_ADDR(SPDR))
+    :
+  );
+  return result;
+ #else
   return readEnd();
+ #endif
 }
 
 
@@ -340,46 +601,124 @@ uint32_t Cart::readPendingLastUInt32()
 
 void Cart::readBytes(uint8_t* buffer, size_t length)
 {
+  uint8_t owner = busOwner;  // CART_BUS_STREAM directly after a seek or bulk read, CART_BUS_FLASH after pending reads
+  busOwner = CART_BUS_FLASH; // the position is updated once after the bytes are read
   for (size_t i = 0; i < length; i++)
   {
-    buffer[i] = readPendingUInt8();
+    wait();
+    buffer[i] = readUnsafe();
   }
+  readAddress += length;
+  busOwner = owner;
 }
 
 
 void Cart::readBytesEnd(uint8_t* buffer, size_t length)
 {
-  for (size_t i = 0; i <= length; i++)
-  {
-    if ((i+1) != length)
-    buffer[i] = readPendingUInt8();
-    else
-    {
-      buffer[i] = readEnd();
-      break;
-    }
-  }
+  if (length == 0) return;
+  readBytes(buffer, length - 1);
+  buffer[length - 1] = readEnd();
 }
 
 
 uint8_t Cart::readEnd()
 {
+  busOwner = CART_BUS_FLASH; // no byte is pending after reading the last one
   wait();                 // wait for a pending read to complete
   return readUnsafeEnd(); // read last byte and disable flash
 }
 
 
+void Cart::readBytesLazyEnd(uint8_t* buffer, size_t length)
+{
+  if (length == 0)
+  {
+    readEnd();
+    return;
+  }
+  readBytes(buffer, length - 1);
+  bool known = busOwner == CART_BUS_STREAM; // readAddress is not tracked after pending reads
+  busOwner = CART_BUS_FLASH;
+  wait();
+  buffer[length - 1] = SPDR; // read last byte without starting the next read
+  readAddress++;             // flash stays selected at the next byte
+  readOpen = known;
+  busOwner = CART_BUS_IDLE;  // an interrupt handler may end the open read
+}
+
+
 void Cart::readDataBytes(uint24_t address, uint8_t* buffer, size_t length)
 {
   seekData(address);
-  readBytesEnd(buffer, length);
+  readBytesLazyEnd(buffer, length);
+}
+
+
+void Cart::readDataRanges(CartRead* reads, uint8_t count)
+{
+  // sort ranges by address (insertion sort, lists are short and often sorted already)
+  for (uint8_t i = 1; i < count; i++)
+  {
+    CartRead read = reads[i];
+    uint8_t j = i;
+    for (; j && (reads[j - 1].address > read.address); j--) reads[j] = reads[j - 1];
+    reads[j] = read;
+  }
+  // read ranges that are close together in a single read command
+  bool reading = false;
+  uint24_t position;
+  for (CartRead* read = reads; read < reads + count; read++)
+  {
+    if (read->length == 0) continue;
+    if (reading && ((read->address < position) || (read->address - position > CART_READ_GAP)))
+    {
+      readEnd();
+      reading = false;
+    }
+    if (!reading)
+    {
+      seekData(read->address);
+      position = read->address;
+      reading = true;
+    }
+    for (; position < read->address; position++) readPendingUInt8(); // skip gap
+    readBytes(read->buffer, read->length);
+    position += read->length;
+  }
+  if (reading) readEnd();
 }
 
 
 void Cart::readSaveBytes(uint24_t address, uint8_t* buffer, size_t length)
 {
   seekSave(address);
-  readBytesEnd(buffer, length);
+  readBytesLazyEnd(buffer, length);
+}
+
+
+void Cart::readSegmentBytes(uint24_t address, uint8_t* buffer, size_t length)
+{
+  seekSegment(address);
+  readBytesLazyEnd(buffer, length);
+}
+
+
+uint8_t Cart::loadSegments()
+{
+  // segment pages are stored relative to the program data area so the table is
+  // only read once and switching segments does not require any flash access
+  seekData(0);
+  segmentCount = 0;
+  if (readPendingUInt16() == CART_SEGMENT_KEY)
+  {
+    uint8_t count = readPendingUInt8();
+    if (count > CART_SEGMENTS) count = CART_SEGMENTS;
+    readPendingUInt8(); // reserved
+    while (segmentCount < count) segmentPages[segmentCount++] = programDataPage + readPendingUInt16();
+  }
+  readEnd();
+  segmentPage = segmentCount ? segmentPages[0] : programDataPage;
+  return segmentCount;
 }
 
 
@@ -404,14 +743,148 @@ void Cart::writeSavePage(uint16_t page, uint8_t* buffer)
   disable();
 }
 
-void Cart::drawBitmap(int16_t x, int16_t y, uint24_t address, uint8_t frame, uint8_t mode)
+
+void Cart::displayFrame(uint24_t address)
+{
+  uint8_t buffer[CART_DISPLAY_BUFFER_SIZE];
+  for (uint16_t offset = 0; offset < WIDTH * HEIGHT / 8; offset += sizeof(buffer))
+  {
+    readDataBytes(address + offset, buffer, sizeof(buffer)); // leaves flash selected
+    enableOLED();                                            // ends the read and selects the display
+    uint8_t* ptr = buffer;
+    SPDR = *ptr++;
+    do                                                       // load the next byte while the current one is sent
+    {
+      uint8_t data = *ptr++;
+      wait();
+      SPDR = data;
+    }
+    while (ptr < buffer + sizeof(buffer));
+    wait();
+    disableOLED();
+  }
+}
+
+void Cart::setTarget(uint8_t* buffer, uint8_t width, uint8_t pages)
+{
+  target.buffer = buffer;
+  target.width  = width;
+  target.pages  = pages;
+}
+
+
+void Cart::resetTarget()
+{
+  setTarget(Arduboy2Base::sBuffer, WIDTH, HEIGHT / 8);
+}
+
+
+void Cart::drawTarget(const CartTarget& source, int16_t x, int8_t page)
+{
+  // clip source to current target and copy visible part of each page row
+  int16_t skipleft = x < 0 ? -x : 0;
+  int16_t length = (x + source.width > target.width ? target.width - x : source.width) - skipleft;
+  if (length <= 0) return;
+  for (uint8_t row = 0; row < source.pages; row++)
+  {
+    int8_t displayrow = page + row;
+    if (displayrow < 0) continue;
+    if (displayrow >= target.pages) break;
+    memcpy(target.buffer + displayrow * target.width + x + skipleft, source.buffer + row * source.width + skipleft, length);
+  }
+}
+
+
+void Cart::drawBitmap(int16_t x, int16_t y, uint24_t address, uint16_t frame, uint8_t mode)
 {
   // read bitmap dimensions from flash
   seekData(address);
   int16_t width  = readPendingUInt16();
   int16_t height = readPendingLastUInt16();
-  // return if the bitmap is completely off screen
-  if (x + width <= 0 || x >= WIDTH || y + height <= 0 || y >= HEIGHT) return;
+  drawBitmapData(x, y, address + 4, width, height, frame, mode);
+}
+
+
+void Cart::drawAtlasBitmap(int16_t x, int16_t y, uint24_t address, const CartAtlasRect& rect, uint8_t mode)
+{
+  drawAtlasBitmap(x, y, loadSprite(address), rect, mode);
+}
+
+
+void Cart::drawAtlasBitmap(int16_t x, int16_t y, const CartSprite& atlas, const CartAtlasRect& rect, uint8_t mode)
+{
+  // the rectangle starts on a page row so its rows are read with the atlas width as stride
+  uint24_t offset = (uint24_t)rect.page * atlas.width + rect.left;
+  if (mode & dbmMasked) offset += offset; // double for masked bitmaps
+  drawBitmapData(x, y, atlas.data + offset, rect.width, rect.height, 0, mode, atlas.width);
+}
+
+
+CartSprite Cart::loadSprite(uint24_t address)
+{
+  seekData(address);
+  int16_t width  = readPendingUInt16();
+  int16_t height = readPendingLastUInt16();
+  return {address + 4, width, height};
+}
+
+
+void Cart::drawTrimmedBitmap(int16_t x, int16_t y, uint24_t address, uint16_t frame, uint8_t mode)
+{
+  // read trim rectangle of frame from frame table
+  seekDataArray16(address + 4, frame, 0, CART_TRIM_ENTRY_SIZE);
+  uint24_t offset = readPendingUInt24();
+  uint8_t left    = readPendingUInt8();
+  uint8_t top     = readPendingUInt8();
+  uint8_t width   = readPendingUInt8();
+  uint8_t height  = readEnd();
+  if (width == 0) return; // fully transparent frame
+  if (mode & (dbmFlipX | dbmFlipY)) // mirror trim rectangle within untrimmed frame
+  {
+    seekData(address);
+    int16_t frameWidth  = readPendingUInt16();
+    int16_t frameHeight = readPendingLastUInt16();
+    if (mode & dbmFlipX) left = frameWidth - left - width;
+    if (mode & dbmFlipY) top = frameHeight - top - height;
+  }
+  drawBitmapData(x + left, y + top, address + offset, width, height, 0, mode);
+}
+
+
+static const uint8_t reverseBitsTable[256] PROGMEM = // bitmap bytes with their 8 vertical pixels mirrored
+{
+  0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+  0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+  0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+  0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+  0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+  0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+  0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+  0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+  0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+  0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+  0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+  0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+  0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+  0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+  0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+  0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+};
+
+
+static inline uint8_t reverseBits(uint8_t b)
+{
+  return pgm_read_byte(reverseBitsTable + b);
+}
+
+
+void Cart::drawBitmapData(int16_t x, int16_t y, uint24_t address, int16_t width, int16_t height, uint16_t frame, uint8_t mode, int16_t stride)
+{
+  if (stride == 0) stride = width;
+  const uint8_t targetwidth = target.width;
+  const int16_t targetheight = target.pages << 3;
+  // return if the bitmap is completely off target
+  if (x + width <= 0 || x >= targetwidth || y + height <= 0 || y >= targetheight) return;
 
   // determine render width
   int16_t skipleft = 0;
@@ -419,49 +892,76 @@ void Cart::drawBitmap(int16_t x, int16_t y, uint24_t address, uint8_t frame, uin
   if (x<0)
   {
     skipleft = -x;
-    if (width - skipleft < WIDTH) renderwidth = width - skipleft;
-    else renderwidth = WIDTH;
+    if (width - skipleft < targetwidth) renderwidth = width - skipleft;
+    else renderwidth = targetwidth;
   }
   else
   {
-    if (x + width > WIDTH) renderwidth = WIDTH - x;
+    if (x + width > targetwidth) renderwidth = targetwidth - x;
     else renderwidth = width;
   }
 
-  //determine render height
-  int16_t skiptop;     // pixel to be skipped at the top
-  int8_t renderheight; // in pixels
-  if (y < 0)
+  // a horizontally mirrored bitmap is read from the mirrored side and drawn
+  // from right to left
+  int16_t column = skipleft;
+  if (mode & dbmFlipX) column = width - skipleft - renderwidth;
+
+  // a vertically mirrored bitmap is drawn with its page rows in reverse order
+  // and reversed bytes. The unused bits of its last page row end up above it
+  uint8_t rows = (height + 7) >> 3;
+  uint8_t lastmask = bitShiftRightMaskUInt8(-height); // used pixels in last page row
+  if (mode & dbmFlipY)
   {
-    skiptop = -y & -8; // optimized -y / 8 * 8
-    if (height - skiptop <= HEIGHT) renderheight = height - skiptop;
-    else renderheight = HEIGHT + (y & 7);
-    skiptop >>= 3;//pixels to displayrows
+    y -= -height & 7;
+    lastmask = reverseBits(lastmask);
   }
-  else
+
+  //determine render rows
+  uint8_t skiptop = 0; // page rows above the target
+  if (y < 0) skiptop = -y >> 3;
+  uint8_t rowcount = rows - skiptop; // page rows to be rendered
+  if (y + (rows << 3) > targetheight) rowcount = ((targetheight + 7 - y) >> 3) - skiptop;
+  uint8_t source = skiptop; // first page row rendered
+  uint8_t rowmask = 0xFF; // mask of the first rendered page row, lastmask is used for the last one
+  if (mode & dbmFlipY)
   {
-    skiptop = 0;
-    if (y + height > HEIGHT) renderheight = HEIGHT - y;
-    else renderheight = height;
+    source = rows - 1 - skiptop;
+    if (skiptop == 0) rowmask = lastmask;
+    lastmask = rowcount == 1 ? rowmask : 0xFF;
   }
-  uint24_t offset = (uint24_t)(frame * ((height+7) / 8) + skiptop) * width + skipleft;
+  else if (skiptop + rowcount < rows) lastmask = 0xFF; // last page row is not rendered
+  uint24_t offset = (multiplyUInt16ByUInt8(frame, rows) + source) * stride + column;
   if (mode & dbmMasked)
   {
     offset += offset; // double for masked bitmaps
-    width += width;
+    stride += stride;
   }
-  address += offset + 4; // skip non rendered pixels, width, height
+  if (mode & dbmFlipY) stride = -stride; // page rows are read upwards
+  address += offset; // skip non rendered pixels
   int8_t displayrow = (y >> 3) + skiptop;
-  uint16_t displayoffset = displayrow * WIDTH + x + skipleft;
+  const int8_t lastrow = target.pages - 1;
+  uint8_t* buffer = target.buffer + displayrow * targetwidth + x + skipleft;
+  uint8_t columnstep = targetwidth - 1; // from the extra row to the next column
+  if (mode & dbmFlipX)
+  {
+    buffer += renderwidth - 1;
+    columnstep = targetwidth + 1;
+  }
   uint8_t yshift = bitShiftLeftUInt8(y); //shift by multiply
+  // a mul takes 2 cycles and a flash byte about 18, so the kernel is limited by
+  // the bytes it streams. Storing pre-shifted copies of a bitmap would save the
+  // multiplies but stream more bytes per column or an extra page row per draw
+  disable(); // rows select flash directly, end a read left open by a lazy read
 #ifdef ARDUINO_ARCH_AVR
-  uint8_t rowmask;
   uint16_t bitmap;
   asm volatile(
     "1: ;render_row:                                \n"
+    "   ldi     r24, %[busflash]                    \n" // busOwner = CART_BUS_FLASH;
+    "   sts     %[busowner], r24                    \n"
     "   cbi     %[cartport], %[cartbit]             \n"
-    "   ldi     r24, %[cmd]                         \n" // writeByte(SFC_READ);
+    "   lds     r24, %[readcmd]                     \n" // writeByte(readCommand);
     "   out     %[spdr], r24                        \n"
+    "   bst     r24, 4                              \n" // T = (readCommand == SFC_READ4)
     "   lds     r24, %[datapage]+0                  \n" // address + programDataPage;
     "   lds     r25, %[datapage]+1                  \n"
     "   add     r24, %B[address]                    \n"
@@ -469,6 +969,12 @@ void Cart::drawBitmap(int16_t x, int16_t y, uint24_t address, uint8_t frame, uin
     "   in      r0, %[spsr]                         \n" // wait()
     "   sbrs    r0, %[spif]                         \n"
     "   rjmp    .-6                                 \n"
+    "   brtc    .+12                                \n" // if (T) 4-byte address:
+    "   lds     r0, %[bank]                         \n" //   writeByte(addressBank);
+    "   out     %[spdr], r0                         \n"
+    "   in      r0, %[spsr]                         \n" //   wait()
+    "   sbrs    r0, %[spif]                         \n"
+    "   rjmp    .-6                                 \n"
     "   out     %[spdr], r25                        \n" // writeByte(address >> 16);
     "   in      r0, %[spsr]                         \n" // wait()
     "   sbrs    r0, %[spif]                         \n"
@@ -479,57 +985,58 @@ void Cart::drawBitmap(int16_t x, int16_t y, uint24_t address, uint8_t frame, uin
     "   rjmp    .-6                                 \n"
     "   out     %[spdr], %A[address]                \n" // writeByte(address);
     "                                               \n"
-    "   add     %A[address], %A[width]              \n" // address += width;
-    "   adc     %B[address], %B[width]              \n"
+    "   add     %A[address], %A[stride]             \n" // address += stride;
+    "   adc     %B[address], %B[stride]             \n"
     "   adc     %C[address], r1                     \n"
+    "   sbrc    %B[stride], 7                       \n" // negative stride for vertical flip
+    "   dec     %C[address]                         \n"
     "   in      r0, %[spsr]                         \n" // wait();
     "   sbrs    r0, %[spif]                         \n"
     "   rjmp    .-6                                 \n"
     "   out     %[spdr], r1                         \n" // SPDR = 0;
     "                                               \n"
     "   lsl     %[mode]                             \n" // 'clear' mode dbfExtraRow by shifting into carry
-    "   cpi     %[displayrow], %[lastrow]           \n"
+    "   cp      %[displayrow], %[lastrow]           \n"
     "   brge    .+4                                 \n" // row >= lastrow, clear carry
     "   sec                                         \n" // row < lastrow set carry
     "   sbrc    %[yshift], 0                        \n" // yshift != 1, don't change carry state
     "   clc                                         \n" // yshift == 1, clear carry
     "   ror     %[mode]                             \n" // carry to mode dbfExtraRow
     "                                               \n"
-    "   ldi     %[rowmask], 0x02                    \n" // rowmask = 0xFF >> (height & 7);
-    "   sbrs    %[height], 1                        \n"
-    "   ldi     %[rowmask], 0x08                    \n"
-    "   sbrs    %[height], 2                        \n"
-    "   swap    %[rowmask]                          \n"
-    "   sbrs    %[height], 0                        \n"
-    "   lsl     %[rowmask]                          \n"
-    "   dec     %[rowmask]                          \n"
-    "   cpi     %[renderheight], 8                  \n" // if (renderheight >= 8) rowmask = 0xFF;
-    "   brlt    .+2                                 \n"
-    "   ldi     %[rowmask], 0xFF                    \n"
+    "   cpi     %[rowcount], 1                      \n" // if (rowcount == 1) rowmask = lastmask;
+    "   brne    .+2                                 \n"
+    "   mov     %[rowmask], %[lastmask]             \n"
+    "   bst     %[mode], %[flipy]                   \n" // T = vertical flip
+    "   lpm                                         \n" // above code took 10 cycles, wait 8 cycles more for SPI data ready
+    "   lpm                                         \n"
+    "   nop                                         \n"
     "                                               \n"
     "   mov     r25, %[renderwidth]                 \n" // for (c < renderwidth)
     "2: ;render_column:                             \n"
     "   in      r0, %[spdr]                         \n" // read bitmap data
     "   out     %[spdr], r1                         \n" // start next read
-    "                                               \n"
+    "   brts    6f ;reverse_bitmap                  \n" // reverse bitmap data for vertical flip
+    "7: ;render_bitmap:                             \n"
     "   sbrc    %[mode], %[reverseblack]            \n" // test reverse mode
     "   com     r0                                  \n" // reverse bitmap data
     "   mov     r24, %[rowmask]                     \n" // temporary move rowmask
     "   sbrc    %[mode], %[whiteblack]              \n" // for black and white modes:
     "   mov     r24, r0                             \n" // rowmask = bitmap
+    "   and     r24, %[rowmask]                     \n" // unused bits may be set in reverse mode
     "   sbrc    %[mode], %[black]                   \n" // for black mode:
     "   clr     r0                                  \n" // bitmap = 0
     "   mul     r0, %[yshift]                       \n"
     "   movw    %[bitmap], r0                       \n" // bitmap *= yshift
-    "   bst     %[mode], %[masked]                  \n" // if bitmap has no mask:
-    "   brtc    3f ;render_mask                     \n" // skip next part
+    "   sbrs    %[mode], %[masked]                  \n" // if bitmap has no mask:
+    "   rjmp    3f ;render_mask                     \n" // skip next part
     "                                               \n"
-    "   lpm                                         \n" // above code took 11 cycles, wait 7 cycles more for SPI data ready
-    "   lpm                                         \n"
+    "   lpm                                         \n" // above code took 14 cycles, wait 4 cycles more for SPI data ready
     "   clr     r1                                  \n" // restore zero reg
     "                                               \n"
     "   in      r0, %[spdr]                         \n" // read mask data
     "   out     %[spdr],r1                          \n" // start next read
+    "   brts    8f ;reverse_mask                    \n" // reverse mask data for vertical flip
+    "9: ;mask_data:                                 \n"
     "   sbrc    %[mode], %[whiteblack]              \n" //
     "3: ;render_mask:                               \n"
     "   mov     r0, r24                             \n" // get mask in r0
@@ -545,8 +1052,9 @@ void Cart::drawBitmap(int16_t x, int16_t y, uint24_t address, uint8_t frame, uin
     "   eor     %A[bitmap], r24                     \n"
     "   st      %a[buffer], %A[bitmap]              \n"
     "4: ;render_page1:                              \n"
-    "   subi    %A[buffer], lo8(-%[displaywidth])   \n"
-    "   sbci    %B[buffer], hi8(-%[displaywidth])   \n"
+    "   add     %A[buffer], %[displaywidth]         \n" // buffer += displaywidth (r1 holds mask MSB)
+    "   brcc    .+2                                 \n"
+    "   inc     %B[buffer]                          \n"
     "   sbrs    %[mode], %[extrarow]                \n" // test if ExtraRow mode:
     "   rjmp    5f ;render_next                     \n" // else skip
     "                                               \n"
@@ -558,113 +1066,465 @@ void Cart::drawBitmap(int16_t x, int16_t y, uint24_t address, uint8_t frame, uin
     "   st      %a[buffer], %B[bitmap]              \n"
     "5: ;render_next:                               \n"
     "   clr     r1                                  \n" // restore zero reg
-    "   subi    %A[buffer], lo8(%[displaywidth]-1)  \n" 
-    "   sbci    %B[buffer], hi8(%[displaywidth]-1)  \n"
+    "   sub     %A[buffer], %[columnstep]           \n" // next column (previous when flipped horizontally)
+    "   sbc     %B[buffer], r1                      \n"
     "   dec     r25                                 \n"
     "   brne    2b ;render_column                   \n" // for (c < renderheigt) loop
+    "   rjmp    10f ;render_row_end                 \n"
     "                                               \n"
-    "   subi    %A[buffer], lo8(-%[displaywidth])   \n" // buffer += WIDTH - renderwidth
-    "   sbci    %B[buffer], hi8(-%[displaywidth])   \n"
+    "6: ;reverse_bitmap:                            \n"
+    "   ldi     r30, lo8(%[reverse])                \n" // r0 = reverseBitsTable[r0]
+    "   ldi     r31, hi8(%[reverse])                \n"
+    "   add     r30, r0                             \n"
+    "   adc     r31, r1                             \n"
+    "   lpm     r0, Z                               \n"
+    "   rjmp    7b ;render_bitmap                   \n"
+    "8: ;reverse_mask:                              \n"
+    "   ldi     r30, lo8(%[reverse])                \n" // r0 = reverseBitsTable[r0]
+    "   ldi     r31, hi8(%[reverse])                \n"
+    "   add     r30, r0                             \n"
+    "   adc     r31, r1                             \n"
+    "   lpm     r0, Z                               \n"
+    "   rjmp    9b ;mask_data                       \n"
+    "                                               \n"
+    "10: ;render_row_end:                           \n"
+    "   add     %A[buffer], %[displaywidth]         \n" // buffer += displaywidth - renderwidth
+    "   adc     %B[buffer], r1                      \n"
     "   sub     %A[buffer], %[renderwidth]          \n"
     "   sbc     %B[buffer], r1                      \n"
-    "   subi    %[renderheight], 8                  \n" // reinderheight -= 8
+    "   sbrs    %[mode], %[flipx]                   \n" // buffer += displaywidth + renderwidth when flipped horizontally
+    "   rjmp    11f                                 \n"
+    "   add     %A[buffer], %[renderwidth]          \n"
+    "   adc     %B[buffer], r1                      \n"
+    "   add     %A[buffer], %[renderwidth]          \n"
+    "   adc     %B[buffer], r1                      \n"
+    "11:                                            \n"
+    "   ldi     %[rowmask], 0xFF                    \n" // rowmask = 0xFF;
     "   inc     %[displayrow]                       \n" // displayrow++
     "   in      r0, %[spsr]                         \n" // clear SPI status
     "   sbi     %[cartport], %[cartbit]             \n" // disable cart
-    "   cp      r1, %[renderheight]                 \n" // while (renderheight > 0)
-    "   brge    .+2                                 \n"
+    "   sts     %[busowner], r1                     \n" // busOwner = CART_BUS_IDLE; (interrupt handlers may use the cart between rows)
+    "   dec     %[rowcount]                         \n" // while (--rowcount)
+    "   breq    .+2                                 \n"
     "   rjmp    1b ;render_row                      \n" 
    :
     [address]      "+r" (address),
     [mode]         "+r" (mode),
-    [rowmask]      "=&d" (rowmask),
+    [rowmask]      "+d" (rowmask),
     [bitmap]       "=&r" (bitmap),
-    [renderheight] "+d" (renderheight),
-    [displayrow]   "+d" (displayrow)
+    [rowcount]     "+d" (rowcount),
+    [displayrow]   "+d" (displayrow),
+    [buffer]       "+e" (buffer)
    :
-    [width]        "r" (width),
-    [height]       "r" (height),
+    [stride]       "r" (stride),
     [yshift]       "r" (yshift),
     [renderwidth]  "r" (renderwidth),
-    [buffer]       "e" (Arduboy2Base::sBuffer + displayoffset),
+    [columnstep]   "r" (columnstep),
+    [lastmask]     "r" (lastmask),
+    [displaywidth] "r" (targetwidth),
+    [lastrow]      "r" (lastrow),
     
     [cartport]     "I" (_SFR_IO_ADDR(CART_PORT)),
     [cartbit]      "I" (CART_BIT),
-    [cmd]          "I" (SFC_READ),
+    [readcmd]      ""  (&readCommand),
+    [busowner]     ""  (&busOwner),
+    [busflash]     "M" (CART_BUS_FLASH),
+    [bank]         ""  (&addressBank),
     [spdr]         "I" (_SFR_IO_ADDR(SPDR)),
     [datapage]     ""  (&programDataPage),
     [spsr]         "I" (_SFR_IO_ADDR(SPSR)),
     [spif]         "I" (SPIF),
-    [lastrow]      "I" (HEIGHT / 8 - 1),
-    [displaywidth] ""  (WIDTH),
     [reverseblack] "I" (dbfReverseBlack),
     [whiteblack]   "I" (dbfWhiteBlack),
     [black]        "I" (dbfBlack),
     [masked]       "I" (dbfMasked),
     [invert]       "I" (dbfInvert),
-    [extrarow]     "I" (dbfExtraRow)
+    [extrarow]     "I" (dbfExtraRow),
+    [flipx]        "I" (dbfFlipX),
+    [flipy]        "I" (dbfFlipY),
+    [reverse]      ""  (reverseBitsTable)
    :
-    "r24", "r25"
+    "r24", "r25", "r30", "r31"
    );
 #else
-  uint8_t lastmask = bitShiftRightMaskUInt8(height); // mask for bottom most pixels
   do
   {
     seekData(address);
-    address += width;
+    busOwner = CART_BUS_FLASH; // row is read with readUnsafe
+    address += stride;
     mode &= ~(_BV(dbfExtraRow));
-    if (yshift != 1 && displayrow < (HEIGHT / 8 - 1)) mode |= _BV(dbfExtraRow);
-    uint8_t rowmask = 0xFF;
-    if (renderheight < 8) rowmask = lastmask;
+    if (yshift != 1 && displayrow < lastrow) mode |= _BV(dbfExtraRow);
+    if (rowcount == 1) rowmask = lastmask;
     wait();
     for (uint8_t c = 0; c < renderwidth; c++)
     {
       uint8_t bitmapbyte = readUnsafe();
+      if (mode & dbmFlipY) bitmapbyte = reverseBits(bitmapbyte);
       if (mode & _BV(dbfReverseBlack)) bitmapbyte ^= 0xFF;
       uint8_t maskbyte = rowmask;
-      if (mode & _BV(dbfWhiteBlack)) maskbyte = bitmapbyte;
+      if (mode & _BV(dbfWhiteBlack)) maskbyte = bitmapbyte & rowmask; // unused bits may be set in reverse mode
       if (mode & _BV(dbfBlack)) bitmapbyte = 0;
       uint16_t bitmap = multiplyUInt8(bitmapbyte, yshift);
       if (mode & _BV(dbfMasked))
       {
         wait();
         uint8_t tmp = readUnsafe();
-        if ((mode & dbfWhiteBlack) == 0) maskbyte = tmp;
+        if (mode & dbmFlipY) tmp = reverseBits(tmp);
+        if ((mode & _BV(dbfWhiteBlack)) == 0) maskbyte = tmp;
       }
       uint16_t mask = multiplyUInt8(maskbyte, yshift);
       if (displayrow >= 0)
       {
         uint8_t pixels = bitmap;
-        uint8_t display = Arduboy2Base::sBuffer[displayoffset];
+        uint8_t display = buffer[0];
         if ((mode & _BV(dbfInvert)) == 0) pixels ^= display;
         pixels &= mask;
         pixels ^= display;
-        Arduboy2Base::sBuffer[displayoffset] = pixels;
+        buffer[0] = pixels;
       }
       if (mode & _BV(dbfExtraRow))
       {
-        uint8_t display = Arduboy2Base::sBuffer[displayoffset + WIDTH];
+        uint8_t display = buffer[targetwidth];
         uint8_t pixels = bitmap >> 8;
-        if ((mode & dbfInvert) == 0) pixels ^= display;
+        if ((mode & _BV(dbfInvert)) == 0) pixels ^= display;
         pixels &= mask >> 8;
         pixels ^= display;
-        Arduboy2Base::sBuffer[displayoffset + WIDTH] = pixels;
+        buffer[targetwidth] = pixels;
       }
-      displayoffset++;
+      buffer += targetwidth - columnstep;
     }
-    displayoffset += WIDTH - renderwidth;
+    buffer += targetwidth - renderwidth;
+    if (mode & dbmFlipX) buffer += renderwidth + renderwidth;
+    rowmask = 0xFF;
     displayrow ++;
-    renderheight -= 8;
     readEnd();
-  } while (renderheight > 0);
+  } while (--rowcount);
 #endif
 }
 
 
+void Cart::setFont(uint24_t address, uint8_t mode)
+{
+  // the header is only read once. Drawing text does not need any metrics reads
+  seekData(address);
+  font.height     = readPendingUInt8();
+  font.firstChar  = readPendingUInt8();
+  font.charCount  = readPendingUInt8();
+  uint8_t maxWidth = readPendingUInt8();
+  font.spacing    = readPendingUInt8();
+  font.lineHeight = readEnd();
+  font.glyphSize  = multiplyUInt8(maxWidth, (font.height + 7) >> 3) + 1;
+  font.glyphs     = address + CART_FONT_HEADER_SIZE;
+  textMode = mode;
+}
+
+
+void Cart::setCursor(int16_t x, int16_t y)
+{
+  cursorX = x;
+  cursorLeft = x;
+  cursorY = y;
+}
+
+
+static void drawTextByte(int16_t x, int8_t row, uint8_t pixels)
+{
+  if ((pixels == 0) || (row < 0) || (row >= Cart::target.pages)) return;
+  uint8_t* buffer = Cart::target.buffer + row * Cart::target.width + x;
+  if (Cart::textMode & _BV(dbfInvert)) *buffer ^= pixels;
+  else if (Cart::textMode & _BV(dbfBlack)) *buffer &= ~pixels;
+  else *buffer |= pixels;
+}
+
+
+static void drawGlyphByte(int16_t x, int8_t row, uint8_t pixels, uint8_t yshift)
+{
+  if ((x < 0) || (x >= Cart::target.width)) return;
+  uint16_t bitmap = Cart::multiplyUInt8(pixels, yshift);
+  drawTextByte(x, row, bitmap);          // top half
+  drawTextByte(x, row + 1, bitmap >> 8); // shifted bottom half
+}
+
+
+void Cart::drawChar(uint8_t c)
+{
+  if (c == '\n')
+  {
+    cursorX = cursorLeft;
+    cursorY += font.lineHeight;
+    return;
+  }
+  c -= font.firstChar;
+  if ((c >= font.charCount) || (cursorX >= target.width)) return;
+
+  // glyphs are stored column by column so a glyph's width and all its pixels
+  // are read in a single flash transaction
+  seekData(font.glyphs + (uint24_t)font.glyphSize * c);
+  uint8_t width = readPendingUInt8();
+  uint8_t pages = (font.height + 7) >> 3;
+  int8_t  displayrow = cursorY >> 3;
+  uint8_t yshift = bitShiftLeftUInt8(cursorY); //shift by multiply
+  int16_t x = cursorX;
+  for (uint8_t column = width; column; column--)
+  {
+    int8_t row = displayrow;
+    for (uint8_t page = pages; page; page--) drawGlyphByte(x, row++, readPendingUInt8(), yshift);
+    x++;
+  }
+  readEnd();
+  cursorX = x + font.spacing;
+}
+
+
+static void drawGlyph(const uint8_t* glyph)
+{
+  // same as drawChar but from glyph data gathered in RAM
+  uint8_t width = *glyph++;
+  uint8_t pages = (Cart::font.height + 7) >> 3;
+  int8_t  displayrow = Cart::cursorY >> 3;
+  uint8_t yshift = Cart::bitShiftLeftUInt8(Cart::cursorY);
+  int16_t x = Cart::cursorX;
+  for (uint8_t column = width; column; column--)
+  {
+    int8_t row = displayrow;
+    for (uint8_t page = pages; page; page--) drawGlyphByte(x, row++, *glyph++, yshift);
+    x++;
+  }
+  Cart::cursorX = x + Cart::font.spacing;
+}
+
+
+void Cart::drawText(const uint8_t* text, uint8_t length)
+{
+  if (font.glyphSize > CART_GLYPH_BUFFER_SIZE)
+  {
+    while (length--) drawChar(*text++); // large glyphs are streamed one at a time
+    return;
+  }
+  uint8_t  glyphs[CART_GLYPH_BUFFER_SIZE];
+  CartRead reads[CART_STRING_GLYPHS];
+  while (length)
+  {
+    // resolve the glyph addresses of as many characters as fit. A glyph used
+    // more than once is only read once
+    uint8_t count = 0;
+    uint8_t n = 0;
+    for (; n < length; n++)
+    {
+      uint8_t c = text[n] - font.firstChar;
+      if (c >= font.charCount) continue; // new line or no glyph
+      uint24_t address = font.glyphs + (uint24_t)font.glyphSize * c;
+      uint8_t i = 0;
+      while ((i < count) && (reads[i].address != address)) i++;
+      if (i < count) continue;
+      if ((count == CART_STRING_GLYPHS) || ((count + 1) * font.glyphSize > CART_GLYPH_BUFFER_SIZE)) break;
+      reads[count].address = address;
+      reads[count].length  = font.glyphSize;
+      reads[count].buffer  = glyphs + count * font.glyphSize;
+      count++;
+    }
+    // one gather pass in address order, glyphs close together share a read command
+    readDataRanges(reads, count);
+    for (uint8_t i = 0; i < n; i++)
+    {
+      uint8_t c = text[i] - font.firstChar;
+      if (c >= font.charCount)
+      {
+        drawChar(text[i]); // new line
+        continue;
+      }
+      if (cursorX >= target.width) continue;
+      uint24_t address = font.glyphs + (uint24_t)font.glyphSize * c;
+      CartRead* read = reads;
+      while (read->address != address) read++;
+      drawGlyph(read->buffer);
+    }
+    text += n;
+    length -= n;
+  }
+}
+
+
+void Cart::drawString(const char* str)
+{
+  drawText(reinterpret_cast<const uint8_t*>(str), strlen(str));
+}
+
+
+void Cart::drawString(const __FlashStringHelper* str)
+{
+  // copied in small chunks so each chunk's glyphs are gathered in one pass
+  const char* p = reinterpret_cast<const char*>(str);
+  uint8_t buffer[CART_STRING_BUFFER_SIZE];
+  for (;;)
+  {
+    uint8_t length = 0;
+    while ((length < sizeof(buffer)) && (buffer[length] = pgm_read_byte(p++))) length++;
+    drawText(buffer, length);
+    if (length < sizeof(buffer)) return;
+  }
+}
+
+
+void Cart::drawDataString(uint24_t address)
+{
+  // text is read in small chunks and each chunk's glyphs are gathered in one pass
+  uint8_t buffer[CART_STRING_BUFFER_SIZE];
+  for (;;)
+  {
+    readDataBytes(address, buffer, sizeof(buffer));
+    address += sizeof(buffer);
+    uint8_t length = 0;
+    while ((length < sizeof(buffer)) && buffer[length]) length++;
+    drawText(buffer, length);
+    if (length < sizeof(buffer)) return;
+  }
+}
+
+static uint32_t directoryMix(uint32_t key, uint16_t seed) // must match directory-builder.py mix
+{
+  key ^= seed * 0x9E3779B9UL;
+  key ^= key >> 16;
+  key *= 0x7FEB352DUL;
+  key ^= key >> 15;
+  return key;
+}
+
+
+void Cart::resetDirectory()
+{
+  directoryBucketMask = 0;
+  directorySlotMask   = 0;
+  for (uint8_t i = 0; i < CART_ASSET_CACHE_SIZE; i++) assetCache[i].valid = false;
+}
+
+
+CartAsset Cart::findAsset(uint32_t key)
+{
+  CartAssetCacheEntry* entry = assetCache + (key & (CART_ASSET_CACHE_SIZE - 1));
+  if (entry->valid && (entry->key == key)) return entry->asset; // resolved before
+  CartAsset asset = {0, 0};
+  if (directorySlotMask == 0) // read directory header once
+  {
+    seekData(0);
+    if (readPendingUInt16() != CART_DIRECTORY_KEY)
+    {
+      readEnd();
+      return asset; // no directory
+    }
+    uint8_t bucketBits = readPendingUInt8();
+    uint8_t slotBits   = readEnd();
+    if ((bucketBits > CART_DIRECTORY_MAX_BITS) || (slotBits == 0) || (slotBits > CART_DIRECTORY_MAX_BITS)) return asset; // not a valid directory
+    directoryBucketMask = ((uint16_t)1 << bucketBits) - 1;
+    directorySlotMask   = ((uint16_t)1 << slotBits) - 1;
+  }
+  // 1st read: bucket displacement, 2nd read: slot
+  seekDataArray16(4, key & directoryBucketMask, 0, sizeof(uint16_t));
+  uint16_t slot = directoryMix(key, readPendingLastUInt16()) & directorySlotMask;
+  seekDataArray16(4 + ((uint24_t)directoryBucketMask + 1) * 2, slot, 0, CART_DIRECTORY_ENTRY_SIZE);
+  if (readPendingUInt32() != key)
+  {
+    readEnd();
+    return asset; // not found
+  }
+  asset.offset = readPendingUInt24();
+  asset.size   = readPendingLastUInt24();
+  entry->key   = key;
+  entry->asset = asset;
+  entry->valid = true;
+  return asset;
+}
+
+
+static void readMaskRow(uint24_t address, int16_t width, int16_t pages, int16_t page, int16_t column, uint8_t length, uint8_t* mask)
+{
+  // reads mask bytes of a masked bitmap page row. Rows outside the bitmap are empty
+  if ((page < 0) || (page >= pages))
+  {
+    memset(mask, 0, length);
+    return;
+  }
+  Cart::seekData(address + ((uint24_t)(page * width + column) << 1));
+  for (uint8_t i = length; i; i--)
+  {
+    Cart::readPendingUInt8();           // skip bitmap byte
+    *mask++ = Cart::readPendingUInt8();
+  }
+  Cart::readEnd();
+}
+
+
+bool Cart::collide(uint24_t address1, uint16_t frame1, int16_t x1, int16_t y1, uint24_t address2, uint16_t frame2, int16_t x2, int16_t y2)
+{
+  // read bitmap dimensions from flash
+  seekData(address1);
+  int16_t width1  = readPendingUInt16();
+  int16_t height1 = readPendingLastUInt16();
+  seekData(address2);
+  int16_t width2  = readPendingUInt16();
+  int16_t height2 = readPendingLastUInt16();
+
+  // intersect bounding boxes
+  int16_t left   = x1 > x2 ? x1 : x2;
+  int16_t right  = x1 + width1 < x2 + width2 ? x1 + width1 : x2 + width2;
+  int16_t top    = y1 > y2 ? y1 : y2;
+  int16_t bottom = y1 + height1 < y2 + height2 ? y1 + height1 : y2 + height2;
+  if ((left >= right) || (top >= bottom)) return false;
+
+  // 1st bitmap page rows that overlap and matching 2nd bitmap page rows
+  int16_t pages1 = (height1 + 7) >> 3;
+  int16_t pages2 = (height2 + 7) >> 3;
+  int16_t firstPage = (top - y1) >> 3;
+  int16_t lastPage  = (bottom - 1 - y1) >> 3;
+  int16_t row2 = y1 + (firstPage << 3) - y2; // 2nd bitmap row at top of 1st bitmap page
+  int16_t firstPage2 = row2 >> 3;
+  uint8_t yshift = bitShiftLeftUInt8(8 - (row2 & 7)); //shift by multiply
+  address1 += 4 + (multiplyUInt16ByUInt8(frame1, pages1) * width1 << 1);
+  address2 += 4 + (multiplyUInt16ByUInt8(frame2, pages2) * width2 << 1);
+
+  // compare overlapping mask columns in strips
+  uint8_t mask1[CART_COLLIDE_STRIP];
+  uint8_t upper[CART_COLLIDE_STRIP];
+  uint8_t lower[CART_COLLIDE_STRIP];
+  for (int16_t x = left; x < right; x += CART_COLLIDE_STRIP)
+  {
+    uint8_t length = right - x < CART_COLLIDE_STRIP ? right - x : CART_COLLIDE_STRIP;
+    int16_t page2 = firstPage2;
+    readMaskRow(address2, width2, pages2, page2, x - x2, length, upper);
+    for (int16_t page = firstPage; page <= lastPage; page++)
+    {
+      readMaskRow(address1, width1, pages1, page, x - x1, length, mask1);
+      readMaskRow(address2, width2, pages2, ++page2, x - x2, length, lower);
+      for (uint8_t i = 0; i < length; i++)
+      {
+        uint8_t mask2 = upper[i];
+        if (row2 & 7) mask2 = (multiplyUInt8(upper[i], yshift) >> 8) | multiplyUInt8(lower[i], yshift);
+        if (mask1[i] & mask2) return true; // first overlapping pixel found
+        upper[i] = lower[i];
+      }
+    }
+  }
+  return false;
+}
+
 void Cart::readDataArray(uint24_t address, uint8_t index, uint8_t offset, uint8_t elementSize, uint8_t* buffer, size_t length)
 {
   seekDataArray(address, index, offset, elementSize);
-  readBytesEnd(buffer, length);
+  readBytesLazyEnd(buffer, length);
+}
+
+
+void Cart::readDataArray16(uint24_t address, uint16_t index, uint8_t offset, uint8_t elementSize, uint8_t* buffer, size_t length)
+{
+  seekDataArray16(address, index, offset, elementSize);
+  readBytesLazyEnd(buffer, length);
+}
+
+
+void Cart::readDataArray2D(uint24_t address, uint16_t row, uint16_t column, uint16_t rowSize, uint8_t* buffer, size_t length)
+{
+  seekDataArray2D(address, row, column, rowSize);
+  readBytesLazyEnd(buffer, length);
 }
 
 
@@ -691,6 +1551,6 @@ uint24_t Cart::readIndexedUInt24(uint24_t address, uint8_t index)
 
 uint32_t Cart::readIndexedUInt32(uint24_t address, uint8_t index)
 {
-  seekDataArray(address, index, 0, sizeof(uint24_t));
+  seekDataArray(address, index, 0, sizeof(uint32_t));
   return readPendingLastUInt32();
 }
\ No newline at end of file
@@ -12,6 +12,8 @@
   #define USE_ARDUBOY2_SPITRANSFER
 #endif
 
+//#define CART_BUS_COUNTERS // count read commands and elided seeks (drawballs-test shows them per frame)
+
 //sketch data and save cart space pages(set by PC manager tool)
 constexpr uint16_t CART_VECTOR_KEY  = 0x9518; /* RETI instruction used a magic key */
 constexpr uint16_t CART_DATA_VECTOR = 0x0014; /* reserved interrupt vector 5  area */
@@ -26,8 +28,11 @@ constexpr uint8_t SFC_READSTATUS2       = 0x35;
 constexpr uint8_t SFC_READSTATUS3       = 0x15;
 constexpr uint8_t SFC_READ              = 0x03;
 constexpr uint8_t SFC_WRITE_ENABLE      = 0x06;
-constexpr uint8_t SFC_WRITE             = 0x04;
+constexpr uint8_t SFC_WRITE             = 0x02;
 constexpr uint8_t SFC_ERASE             = 0x20;
+constexpr uint8_t SFC_READ4             = 0x13; // 4-byte address versions for flash memory larger than 16MB
+constexpr uint8_t SFC_WRITE4            = 0x12;
+constexpr uint8_t SFC_ERASE4            = 0x21;
 constexpr uint8_t SFC_RELEASE_POWERDOWN = 0xAB;
 constexpr uint8_t SFC_POWERDOWN         = 0xB9;
 
@@ -37,6 +42,8 @@ constexpr uint8_t dbfInvert       = 1; // bitmap is exclusive or-ed with display
 constexpr uint8_t dbfBlack        = 2; // bitmap will be blackened
 constexpr uint8_t dbfReverseBlack = 3; // reverses bitmap data
 constexpr uint8_t dbfMasked       = 4; // bitmap contains mask data
+constexpr uint8_t dbfFlipX        = 5; // bitmap is mirrored horizontally
+constexpr uint8_t dbfFlipY        = 6; // bitmap is mirrored vertically
 constexpr uint8_t dbfExtraRow     = 7; // ignored (internal use)
 
 //drawBitmap modes with same behaviour as Arduboy library drawBitmap modes
@@ -62,11 +69,52 @@ constexpr uint8_t dbmReverse = _BV(dbfReverseBlack);    // White pixels in bitma
 constexpr uint8_t dbmMasked  = _BV(dbfMasked);          // The bitmap contains a mask that will determine which pixels are
                                                         // drawn and which will remain 
                                                         // (same as sprites drawPlusMask)
+
+constexpr uint8_t dbmFlipX   = _BV(dbfFlipX);           // The bitmap is drawn mirrored horizontally (facing the other way)
+
+constexpr uint8_t dbmFlipY   = _BV(dbfFlipY);           // The bitmap is drawn mirrored vertically (upside down)
                                      
 // Note above modes may be combined like (dbmMasked | dbmReverse)
                                      
 using uint24_t = __uint24;
 
+//trimmed bitmap frame table entry (created by sprite-trimmer.py): offset (24-bit), left, top, width, height
+constexpr uint8_t CART_TRIM_ENTRY_SIZE = 7;
+
+//number of columns compared at once by collide
+constexpr uint8_t CART_COLLIDE_STRIP = 16;
+
+//asset directory at the start of the program data area (created by directory-builder.py)
+constexpr uint16_t CART_DIRECTORY_KEY        = 0x4449; // 'DI'
+constexpr uint8_t  CART_DIRECTORY_ENTRY_SIZE = 10;     // key (32-bit), offset (24-bit), size (24-bit)
+constexpr uint8_t  CART_ASSET_CACHE_SIZE     = 8;      // number of resolved assets kept in RAM (power of 2)
+constexpr uint8_t  CART_DIRECTORY_MAX_BITS   = 15;     // largest bucket and slot bits accepted in the directory header
+
+//owner of the SPI bus shared by flash memory and display (Cart::busOwner). Interrupt handlers may use the cart
+//between Cart::suspend() and Cart::resume() unless a transfer of unknown position is in progress
+constexpr uint8_t CART_BUS_IDLE   = 0; // nothing selected (or only a read left open by a lazy read)
+constexpr uint8_t CART_BUS_STREAM = 1; // flash read in progress, readAddress is the address of the byte being transfered (after a seek or bulk read)
+constexpr uint8_t CART_BUS_FLASH  = 2; // flash command, bulk read or run of pending reads in progress (until readEnd)
+constexpr uint8_t CART_BUS_OLED   = 3; // display transfer in progress
+
+//scatter-gather reads and lazy seeks: gaps up to this many bytes are read and discarded instead of starting a new read command
+constexpr uint8_t CART_READ_GAP = 5;
+
+//segment table at the start of the program data area (created by segment-builder.py)
+constexpr uint16_t CART_SEGMENT_KEY = 0x5347; // 'SG'
+constexpr uint8_t  CART_SEGMENTS    = 8;      // maximum number of segments
+
+//font header (created by font-converter.py)
+constexpr uint8_t CART_FONT_HEADER_SIZE  = 6;  // height, first char, char count, max width, spacing, line height
+constexpr uint8_t CART_STRING_BUFFER_SIZE = 16; // chunk size used when drawing strings stored in flash memory
+constexpr uint8_t CART_GLYPH_BUFFER_SIZE  = 64; // glyph data gathered in one pass when drawing a string (larger glyphs are streamed)
+constexpr uint8_t CART_STRING_GLYPHS      = 8;  // distinct glyphs gathered in one pass
+constexpr uint8_t CART_DISPLAY_BUFFER_SIZE = 64; // chunk size used by displayFrame (bounce buffer on stack)
+
+//JEDEC ID size byte (2^size bytes) range of flash memory that requires 4-byte addresses (32MB up to 2Gbit parts)
+constexpr uint8_t CART_JEDEC_SIZE_4BYTE = 0x19;
+constexpr uint8_t CART_JEDEC_SIZE_MAX   = 0x22; // larger values are not a valid size (no cart reads 0xFF)
+
 struct JedecID
 {
   uint8_t manufacturer;
@@ -74,35 +122,112 @@ struct JedecID
   uint8_t size;
 };
 
+struct CartRead
+{
+  uint24_t address; // offset in program data area
+  uint16_t length;
+  uint8_t* buffer;  // destination in RAM
+};
+
 struct CartAddress
 {
   uint16_t page;
   uint8_t  offset;
 };
 
+struct CartAsset
+{
+  uint24_t offset; // offset in program data area
+  uint24_t size;   // size in bytes. 0 when the asset was not found
+};
+
+struct CartAssetCacheEntry
+{
+  uint32_t  key;
+  CartAsset asset;
+  bool      valid; // any key value including 0 can be a real key
+};
+
+constexpr uint32_t cartAssetKey(const char* name, uint32_t hash = 2166136261UL) // FNV-1a hash of asset name (evaluated at compile time)
+{
+  return *name ? cartAssetKey(name + 1, (hash ^ (uint8_t)*name) * 16777619UL) : hash;
+}
+
+struct CartSprite
+{
+  uint24_t data;   // offset of the pixel data in program data area (past the width, height header)
+  int16_t  width;  // in pixels
+  int16_t  height; // in pixels
+};
+
+struct CartAtlasRect
+{
+  uint8_t left;   // in pixels
+  uint8_t page;   // top in pages of 8 pixels
+  uint8_t width;  // in pixels
+  uint8_t height; // in pixels
+};
+
+constexpr CartSprite cartSprite(uint24_t address, int16_t width, int16_t height) // sprite with dimensions known at compile time
+{
+  return {address + 4, width, height};
+}
+
+struct CartTarget
+{
+  uint8_t* buffer; // pixel data in display buffer layout (pages of 8 vertical pixels)
+  uint8_t  width;  // in pixels (at most 254 so bitmaps can be drawn mirrored)
+  uint8_t  pages;  // height in pages of 8 pixels
+};
+
+struct CartFont
+{
+  uint24_t glyphs;     // data offset of the first glyph
+  uint16_t glyphSize;  // bytes used by each glyph: width followed by column data
+  uint8_t  height;     // glyph height in pixels
+  uint8_t  firstChar;  // first character in font
+  uint8_t  charCount;  // number of characters in font
+  uint8_t  spacing;    // pixels between two glyphs
+  uint8_t  lineHeight; // pixels between two lines
+};
+
 class Cart
 {
   public:
-    static inline void enableOLED() __attribute__((always_inline)) // selects OLED display.
+    static inline void enableOLED() __attribute__((always_inline)) // selects OLED display. Ends a read left open by a lazy read
     {
+      disable();
+      busOwner = CART_BUS_OLED;
       CS_PORT &= ~(1 << CS_BIT);
     };
 
     static inline void disableOLED() __attribute__((always_inline)) // deselects OLED display.
     {
       CS_PORT |=  (1 << CS_BIT);
+      busOwner = CART_BUS_IDLE;
     };
     
     static inline void enable() __attribute__((always_inline)) // selects external flash memory and allows new commands
     {
+      CART_PORT  |=  (1 << CART_BIT); // ends a read left open by a lazy read
+      readOpen = false;
+      busOwner = CART_BUS_FLASH;
       CART_PORT  &= ~(1 << CART_BIT);
     };
 
     static inline void disable() __attribute__((always_inline)) // deselects external flash memory and ends the last command
     {
       CART_PORT  |=  (1 << CART_BIT);
+      readOpen = false;
+      busOwner = CART_BUS_IDLE;
     };
 
+    static bool suspend(); // for interrupt handlers: frees the bus for the handler's own cart reads. Returns false when the bus is busy (try again later)
+
+    static void resume(); // for interrupt handlers: ends the handler's reads and restarts a suspended read stream by seeking to it again
+
+    static void display(bool clear = false); // sends the display buffer as one transfer that interrupt handlers will not break into (use instead of arduboy.display())
+
     static inline void wait() __attribute__((always_inline)) // wait for a pending flash transfer to complete
     {
       while ((SPSR & _BV(SPIF)) == 0);
@@ -143,15 +268,33 @@ class Cart
 
     static void writeEnable();// Puts flash memory in write mode, required prior to any write command
 
-    static void seekCommand(uint8_t command, uint24_t address);// Write command and selects flash memory address. Required by any read or write command
+    static JedecID readJedecID(); // reads manufacturer, memory type and size of flash memory
+
+    static void selectAddressMode(); // selects 4-byte address commands when flash memory is larger than 16MB (called by begin)
+
+    static inline void setBank(uint8_t bank) __attribute__((always_inline)) // selects the 16MB bank of flash memory used by all seeks (carts larger than 16MB only)
+    {
+      disable(); // a read left open by a lazy read is in the old bank
+      addressBank = bank;
+    }
+
+    static void seekCommand(uint8_t command, uint24_t address);// Write command and selects flash memory address. Required by any read or write command. Sends SFC_READ, SFC_WRITE and SFC_ERASE as 4-byte address commands in the selected bank on carts larger than 16MB
 
     static void seekData(uint24_t address); // selects flashaddress of program data area for reading and starts the first read
     
     static void seekDataArray(uint24_t address, uint8_t index, uint8_t offset, uint8_t elementSize);
 
+    static void seekDataArray16(uint24_t address, uint16_t index, uint8_t offset, uint8_t elementSize); // seekDataArray for arrays with more than 256 elements
+
+    static void seekDataArray2D(uint24_t address, uint16_t row, uint16_t column, uint16_t rowSize); // selects address + row * rowSize + column (for large maps)
+
     static void seekSave(uint24_t address); // selects flashaddress of program save area for reading and starts the first read
+
+    static void seekSegment(uint24_t address); // selects flashaddress within the selected segment for reading and starts the first read
+
+    static void seekRead(uint24_t address); // starts reading at an absolute flash address. Continues a read left open by a lazy read when address is just ahead of it
     
-    static inline uint8_t readUnsafe() __attribute__((always_inline)) // read flash data without performing any checks and starts the next read.
+    static inline uint8_t readUnsafe() __attribute__((always_inline)) // read flash data without performing any checks and starts the next read. Does not track readAddress: set busOwner to CART_BUS_FLASH first when interrupt handlers use the cart
     {
       uint8_t result = SPDR;
       SPDR = 0;
@@ -165,7 +308,7 @@ class Cart
       return result;
     };
     
-    static uint8_t readPendingUInt8() __attribute__ ((noinline));    //read a prefetched byte from the current flash location
+    static uint8_t readPendingUInt8() __attribute__ ((noinline));    //read a prefetched byte from the current flash location. Interrupt handlers can't suspend the read from here until readEnd
     
     static uint8_t readPendingLastUInt8() __attribute__ ((noinline));    //read a prefetched byte from the current flash location
     
@@ -187,17 +330,85 @@ class Cart
     
     static uint8_t readEnd(); //read last pending byte and end read command
 
-    static void readDataBytes(uint24_t address, uint8_t* buffer, size_t length);
+    static void readBytesLazyEnd(uint8_t* buffer, size_t length); // readBytesEnd that leaves the read command open for a following seek (only directly after a seek)
+
+    static void readDataBytes(uint24_t address, uint8_t* buffer, size_t length); // seek and readBytesLazyEnd. Flash stays selected after
+                                                                                 // returning, so code that uses SPI or the OLED directly
+                                                                                 // must call enableOLED() or Cart::display() first
+
+    static void readDataRanges(CartRead* reads, uint8_t count); // reads a list of ranges from the program data area in address order (the list is sorted)
 
     static void readSaveBytes(uint24_t address, uint8_t* buffer, size_t length);
 
+    static void readSegmentBytes(uint24_t address, uint8_t* buffer, size_t length);
+
+    static uint8_t loadSegments(); // reads the segment table at the start of the program data area. Returns the number of segments (0 when there is no table)
+
+    static inline void selectSegment(uint8_t segment) __attribute__((always_inline)) // selects the segment used by seekSegment. Does not access flash memory
+    {
+      segmentPage = segmentPages[segment];
+    }
+
+    static uint24_t segmentAddress(uint8_t segment) // program data address of a segment for use with drawBitmap and other program data functions
+    {
+      return (uint24_t)(segmentPages[segment] - programDataPage) << 8;
+    }
+
     static void eraseSaveBlock(uint16_t page);
 
     static void writeSavePage(uint16_t page, uint8_t* buffer);
 
-    static void drawBitmap(int16_t x, int16_t y, uint24_t address, uint8_t frame, uint8_t mode);
+    static void displayFrame(uint24_t address); // send a 1K full screen image from the program data area directly to the display (without using sBuffer)
+
+    static void drawBitmap(int16_t x, int16_t y, uint24_t address, uint16_t frame, uint8_t mode);
+
+    static inline void drawBitmap(int16_t x, int16_t y, const CartSprite& sprite, uint16_t frame, uint8_t mode) __attribute__((always_inline)) // draws a bitmap without reading its header
+    {
+      drawBitmapData(x, y, sprite.data, sprite.width, sprite.height, frame, mode);
+    }
+
+    static void drawAtlasBitmap(int16_t x, int16_t y, uint24_t address, const CartAtlasRect& rect, uint8_t mode); // draws a sprite packed into an atlas bitmap by atlas-packer.py
+
+    static void drawAtlasBitmap(int16_t x, int16_t y, const CartSprite& atlas, const CartAtlasRect& rect, uint8_t mode); // drawAtlasBitmap without reading the atlas header
+
+    static CartSprite loadSprite(uint24_t address); // reads the width, height header of a bitmap once for drawing it with the sprite drawBitmap
+
+    static void drawTrimmedBitmap(int16_t x, int16_t y, uint24_t address, uint16_t frame, uint8_t mode); // draws only the opaque part of a trimmed bitmap frame
+
+    static void drawBitmapData(int16_t x, int16_t y, uint24_t address, int16_t width, int16_t height, uint16_t frame, uint8_t mode, int16_t stride = 0); // draws bitmap pixel data of known size (address points past the width, height header). stride: width of the bitmap the pixels are part of
+
+    static void setTarget(uint8_t* buffer, uint8_t width, uint8_t pages); // draw bitmaps and text into an off screen buffer
+
+    static void resetTarget(); // draw bitmaps and text to the display buffer again
+
+    static void drawTarget(const CartTarget& source, int16_t x, int8_t page); // copy a composed buffer into the current target at page row
+
+    static CartAsset findAsset(uint32_t key); // look up an asset in the directory using a key created with cartAssetKey("name")
+
+    static void resetDirectory(); // forgets the directory header and resolved assets. Called by begin, call after changing programDataPage
+
+    static bool collide(uint24_t address1, uint16_t frame1, int16_t x1, int16_t y1, // pixel accurate collision test of two masked bitmaps
+                        uint24_t address2, uint16_t frame2, int16_t x2, int16_t y2);
+
+    static void setFont(uint24_t address, uint8_t mode); // selects a font in the program data area. mode: dbmWhite, dbmBlack or dbmInvert
+
+    static void setCursor(int16_t x, int16_t y); // sets text position. x is also used as left margin for new lines
+
+    static void drawChar(uint8_t c); // draw a single character at the cursor and advance the cursor
+
+    static void drawString(const char* str); // draw a string from RAM
+
+    static void drawString(const __FlashStringHelper* str); // draw a string from PROGMEM
+
+    static void drawDataString(uint24_t address); // draw a zero terminated string from the program data area
+
+    static void drawText(const uint8_t* text, uint8_t length); // draw characters from RAM, the distinct glyphs are gathered in one flash pass
     
     static void readDataArray(uint24_t address, uint8_t index, uint8_t offset, uint8_t elementSize, uint8_t* buffer, size_t length);
+
+    static void readDataArray16(uint24_t address, uint16_t index, uint8_t offset, uint8_t elementSize, uint8_t* buffer, size_t length);
+
+    static void readDataArray2D(uint24_t address, uint16_t row, uint16_t column, uint16_t rowSize, uint8_t* buffer, size_t length);
     
     static uint16_t readIndexedUInt8(uint24_t address, uint8_t index);
     
@@ -226,6 +437,29 @@ class Cart
      #endif
     }
     
+    static inline uint24_t multiplyUInt16ByUInt8(uint16_t a, uint8_t b) __attribute__((always_inline))
+    {
+     #ifdef ARDUINO_ARCH_AVR
+      uint24_t result;
+      asm volatile(
+        "mul    %A[a], %[b]         \n"
+        "movw   %A[result], r0      \n"
+        "mul    %B[a], %[b]         \n"
+        "clr    %C[result]          \n"
+        "add    %B[result], r0      \n"
+        "adc    %C[result], r1      \n"
+        "clr    r1                  \n"
+        : [result] "=&r" (result)
+        : [a]      "r"   (a),
+          [b]      "r"   (b)
+        :
+      );
+      return result;
+     #else
+      return ((uint24_t)a * b);
+     #endif
+    }
+    
     static inline uint8_t bitShiftLeftUInt8(uint8_t bit) __attribute__((always_inline)) //fast (1 << (bit & 7))
     {
      #ifdef ARDUINO_ARCH_AVR
@@ -318,5 +552,38 @@ class Cart
     
     static uint16_t programDataPage; // program read only data area in flash memory
     static uint16_t programSavePage; // program read and write data area in flash memory
+
+    static CartTarget target; // buffer drawn into by drawBitmap and text functions
+
+    static uint8_t readCommand; // SFC_READ, or SFC_READ4 when flash memory is larger than 16MB
+    static uint8_t addressBank; // address bits 31-24 sent by 4-byte address commands
+
+    static uint24_t readAddress; // flash address of the read started by the last seek (advanced by bulk reads, not by pending reads), after a lazy read the address of the next byte
+    static bool     readOpen;    // flash is still selected by a lazy read
+
+    static volatile uint8_t busOwner;  // CART_BUS_IDLE, CART_BUS_STREAM, CART_BUS_FLASH or CART_BUS_OLED
+    static uint8_t  suspendedOwner;    // bus state saved by suspend
+    static uint24_t suspendedAddress;
+    static uint8_t  suspendedBank;
+
+   #ifdef CART_BUS_COUNTERS
+    static uint16_t busReadCommands; // read commands sent to flash memory
+    static uint16_t busElidedSeeks;  // seeks that continued an open read instead
+    static uint16_t busGapBytes;     // bytes read and discarded to continue an open read
+   #endif
+
+    static uint16_t segmentPage;                   // flash page of selected segment
+    static uint16_t segmentPages[CART_SEGMENTS];   // flash pages of all segments
+    static uint8_t  segmentCount;
+
+    static uint16_t directoryBucketMask; // asset directory hash table size
+    static uint16_t directorySlotMask;   // 0 when directory has not been read yet
+    static CartAssetCacheEntry assetCache[CART_ASSET_CACHE_SIZE]; // recently resolved assets
+
+    static CartFont font;      // current font selected by setFont
+    static uint8_t  textMode;  // drawing mode for text
+    static int16_t  cursorX;   // text position
+    static int16_t  cursorY;
+    static int16_t  cursorLeft;// left margin used by new lines
 };
 #endif
\ No newline at end of file
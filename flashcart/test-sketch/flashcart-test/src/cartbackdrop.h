@@ -0,0 +1,45 @@
+#ifndef CART_BACKDROP_H
+#define CART_BACKDROP_H
+
+#include "cart.h"
+
+constexpr uint8_t CART_BACKDROP_RECTS = 16; // maximum number of regions restored per frame
+
+struct CartBackdropRect
+{
+  uint8_t left;   // first and last column
+  uint8_t right;
+  uint8_t top;    // first and last page row
+  uint8_t bottom;
+};
+
+// Restores the display buffer from a full screen image in the program data
+// area (display buffer layout, as used by Cart::displayFrame) but only where
+// sprites were drawn during the previous frame, so the cost of a frame depends
+// on the number of moving objects instead of the screen area. Regions are
+// rounded to page rows and read with one flash read per page row and span.
+// When more regions are marked than fit in the list, the new region is merged
+// with the region that grows least.
+
+class CartBackdrop
+{
+  public:
+    void begin(uint24_t address); // the next restore copies the whole screen
+
+    void mark(int16_t x, int16_t y, int16_t width, int16_t height); // region drawn over this frame
+
+    void drawBitmap(int16_t x, int16_t y, const CartSprite& sprite, uint16_t frame, uint8_t mode); // marks and draws a bitmap
+
+    void restore(); // restores the regions marked since the last restore. Call before drawing a new frame
+
+    uint16_t bytesRestored; // bytes read from flash by the last restore
+
+  private:
+    void add(uint8_t left, uint8_t right, uint8_t top, uint8_t bottom);
+
+    CartBackdropRect rects[CART_BACKDROP_RECTS];
+    uint24_t address;
+    uint8_t  count;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef CART_GRAY_H
+#define CART_GRAY_H
+
+#include "cart.h"
+
+constexpr uint8_t  CART_GRAY_PLANES        = 2;    // bitplanes per frame of a gray bitmap (gray-converter.py)
+constexpr uint8_t  CART_GRAY_SUBFRAMES     = 3;    // plane 0 is shown once and plane 1 twice per gray frame: 4 gray levels
+constexpr uint16_t CART_GRAY_PLANE_US      = 7407; // time a plane is shown: 135 planes, 45 gray frames per second
+constexpr uint8_t  CART_GRAY_DISPLAY_CLOCK = 0xF0; // display oscillator setting (fastest, no divide)
+constexpr uint8_t  CART_GRAY_PRECHARGE     = 0x11; // shortest precharge phases so a display scan fits in a plane time
+constexpr uint8_t  CART_GRAY_PARK_MUX      = 15;   // multiplex ratio - 1 while a plane is sent (16 rows, smallest valid value)
+
+// Shows 4 gray levels by drawing the scene once per bitplane and showing the
+// planes in turn. A gray bitmap (created by gray-converter.py) stores each
+// frame as two 1-bit planes that are regular bitmap frames, so plane p of
+// frame f is drawn by Cart::drawBitmap as frame f * 2 + p. drawBitmap below
+// does that for the current plane. Other drawing is done in every plane
+// (white) or only in the planes given by color(level).
+//
+// nextPlane() paces the planes like arduboy.nextFrame() paces frames. The
+// display has no refresh output to synchronise to. begin() speeds up the
+// display refresh so a scan fits in the plane time left after the transfer.
+// When parkScan is set, display() limits the scan to the top 16 rows while
+// the plane is sent and restores all 64 rows after, so the rest of the screen
+// does not show a half sent plane. Parking is off by default because it has
+// not been checked on hardware.
+//
+// Plane rate: 135 planes per second is the target. The rate drawballs-test
+// reaches was only estimated from a host model: about 100 to 120 planes per
+// second with 55 balls, and the full rate with fewer balls. The GRAYSCALE
+// option of drawballs-test shows the rate measured on hardware.
+//
+// void loop()
+// {
+//   if (!gray.nextPlane()) return;
+//   if (gray.frameStart()) update(); // move things once per gray frame
+//   draw();                          // using gray.drawBitmap and gray.color
+//   gray.display();
+// }
+
+class CartGray
+{
+  public:
+    void begin(uint16_t planeTime = CART_GRAY_PLANE_US); // sets up the display refresh for plane switching
+
+    bool nextPlane(); // true when the next plane is due. Draw and display the scene for plane() then
+
+    uint8_t plane() { return subframe ? 1 : 0; } // plane drawn now
+
+    bool frameStart() { return subframe == 0; } // first plane of a gray frame
+
+    bool color(uint8_t level) { return (level >> plane()) & 1; } // pixel color to draw a gray level 0 (black) to 3 (white) with in this plane
+
+    void drawBitmap(int16_t x, int16_t y, uint24_t address, uint16_t frame, uint8_t mode) // draws the current plane of a gray bitmap frame
+    {
+      Cart::drawBitmap(x, y, address, frame * CART_GRAY_PLANES + plane(), mode);
+    }
+
+    void drawBitmap(int16_t x, int16_t y, const CartSprite& sprite, uint16_t frame, uint8_t mode)
+    {
+      Cart::drawBitmap(x, y, sprite, frame * CART_GRAY_PLANES + plane(), mode);
+    }
+
+    void display(); // sends and clears the display buffer (with the display scan parked when parkScan is set)
+
+    bool     parkScan = false; // limit the display scan to CART_GRAY_PARK_MUX + 1 rows while a plane is sent
+    uint16_t planes;     // planes shown (the sketch can reset this to measure the plane rate)
+    uint16_t latePlanes; // planes that started a plane time or more late (drawing took too long)
+
+  private:
+    uint16_t planeTime;
+    uint16_t planeStart; // micros() of the current plane
+    uint8_t  subframe;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "cartmetatile.h"
+
+bool CartMetatileMap::begin(uint24_t address)
+{
+  Cart::seekData(address);
+  width  = Cart::readPendingUInt16();
+  height = Cart::readPendingUInt16();
+  uint8_t size = Cart::readPendingUInt8();
+  Cart::readEnd();
+  shift = 0;
+  if ((size != 2) && (size != 4)) return false;
+  shift     = size >> 1;
+  mapWidth  = (width + size - 1) >> shift;
+  map       = address + CART_METATILE_HEADER_SIZE;
+  metatiles = map + ((uint24_t)mapWidth * ((height + size - 1) >> shift) << 1);
+  cache     = NULL;
+  return true;
+}
+
+
+bool CartMetatileMap::setCache(uint16_t* buffer, uint8_t entries)
+{
+  if (shift == 0) return false; // entry size is not known before begin
+  cache     = buffer;
+  cacheMask = entries - 1;
+  const uint8_t entrySize = 1 + (1 << (shift + shift));
+  for (uint8_t i = 0; i < entries; i++) buffer[i * entrySize] = 0xFFFF; // not a metatile number
+  return true;
+}
+
+
+uint16_t CartMetatileMap::getTile(uint16_t x, uint16_t y)
+{
+  uint16_t metatile;
+  uint16_t tile;
+  const uint8_t mask = (1 << shift) - 1;
+  Cart::readDataBytes(map + (((uint24_t)(y >> shift) * mapWidth + (x >> shift)) << 1), (uint8_t*)&metatile, 2);
+  Cart::readDataBytes(metatileAddress(metatile) + ((((y & mask) << shift) + (x & mask)) << 1), (uint8_t*)&tile, 2);
+  return tile;
+}
+
+
+void CartMetatileMap::readTiles(uint16_t x, uint16_t y, uint8_t columns, uint8_t rows, uint16_t* tiles)
+{
+  const uint8_t size = 1 << shift;
+  uint16_t ids[CART_METATILE_ROW_IDS];
+  uint16_t block[CART_METATILE_MAX_TILES];
+  const uint8_t blockSize = 2 << (shift + shift); // in bytes
+  uint16_t last = (x + columns - 1) >> shift;
+  for (uint16_t my = y >> shift; my <= (y + rows - 1) >> shift; my++)
+    for (uint16_t first = x >> shift; first <= last; first += CART_METATILE_ROW_IDS) // wide windows are read in parts of the row
+    {
+      uint8_t count = last - first < CART_METATILE_ROW_IDS ? last - first + 1 : CART_METATILE_ROW_IDS;
+      Cart::readDataBytes(map + (((uint24_t)my * mapWidth + first) << 1), (uint8_t*)ids, count << 1);
+      for (uint8_t i = 0; i < count; i++)
+      {
+        // a metatile used more than once on a row is read once
+        uint8_t j = 0;
+        while (ids[j] != ids[i]) j++;
+        if (j < i) continue;
+        uint16_t* source = block;
+        if (cache)
+        {
+          uint16_t* entry = cache + (ids[i] & cacheMask) * (1 + (blockSize >> 1));
+          source = entry + 1;
+          if (entry[0] != ids[i])
+          {
+            entry[0] = ids[i];
+            Cart::readDataBytes(metatileAddress(ids[i]), (uint8_t*)source, blockSize);
+          }
+        }
+        else Cart::readDataBytes(metatileAddress(ids[i]), (uint8_t*)block, blockSize);
+        for (uint8_t k = i; k < count; k++)
+        {
+          if (ids[k] != ids[i]) continue;
+          int16_t left = ((first + k) << shift) - x; // metatile location in window
+          int16_t top  = (my << shift) - y;
+          for (uint8_t by = 0; by < size; by++)
+          {
+            if ((top + by < 0) || (top + by >= rows)) continue;
+            for (uint8_t bx = 0; bx < size; bx++)
+            {
+              if ((left + bx < 0) || (left + bx >= columns)) continue;
+              tiles[(top + by) * columns + left + bx] = source[(by << shift) + bx];
+            }
+          }
+        }
+      }
+    }
+}
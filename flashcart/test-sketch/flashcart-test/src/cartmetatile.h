@@ -0,0 +1,44 @@
+#ifndef CART_METATILE_H
+#define CART_METATILE_H
+
+#include "cart.h"
+
+constexpr uint8_t CART_METATILE_HEADER_SIZE = 8;  // width, height, metatile size, reserved, number of metatiles
+constexpr uint8_t CART_METATILE_ROW_IDS     = 12; // metatile numbers read at once, wider windows read a row in several parts
+constexpr uint8_t CART_METATILE_MAX_TILES   = 16; // tiles in the largest (4 x 4) metatile
+
+// Reads tiles from a metatile map created by metatile-converter.py. The map
+// holds a 16-bit metatile number per 2 x 2 or 4 x 4 group of tiles and each
+// distinct group of 16-bit tile numbers is stored once in a metatile table.
+// A window of tiles is read with one read of metatile numbers per metatile
+// row plus one read per distinct metatile in that row. Optionally the sketch
+// provides RAM to keep recently used metatiles so reading a window mostly
+// costs the reads of the metatile numbers.
+
+class CartMetatileMap
+{
+  public:
+    bool begin(uint24_t address); // reads the map header. Returns false for a metatile size other than 2 or 4
+
+    bool setCache(uint16_t* buffer, uint8_t entries); // RAM for entries * (1 + size * size) words. entries must be a power of 2. Returns false before a successful begin
+
+    uint16_t getTile(uint16_t x, uint16_t y); // tile at tile location
+
+    void readTiles(uint16_t x, uint16_t y, uint8_t columns, uint8_t rows, uint16_t* tiles); // window of tiles in rows of columns tiles. Windows wider than
+                                                                                            // CART_METATILE_ROW_IDS metatiles take one read of metatile numbers per part
+
+    uint16_t width;  // in tiles
+    uint16_t height;
+
+  private:
+    uint24_t metatileAddress(uint16_t metatile) { return metatiles + ((uint24_t)metatile << (shift + shift + 1)); }
+
+    uint24_t map;       // metatile numbers
+    uint24_t metatiles; // metatile table
+    uint16_t mapWidth;  // in metatiles
+    uint8_t  shift = 0; // metatile size as power of 2. 0 until begin succeeds
+    uint16_t* cache;    // per entry the metatile number followed by its tiles
+    uint8_t  cacheMask; // entries - 1
+};
+
+#endif
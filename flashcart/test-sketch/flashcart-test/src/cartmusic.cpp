@@ -0,0 +1,119 @@
+#include "cartmusic.h"
+
+constexpr uint8_t CART_MUSIC_HALF_SIZE = CART_MUSIC_HALF_EVENTS * CART_MUSIC_EVENT_SIZE;
+
+void CartMusic::begin()
+{
+  active = false;
+  TCCR3A = 0;                      // timer 3: CTC mode, clock / 8, pin toggled when playing
+  TCCR3B = _BV(WGM32) | _BV(CS31);
+  TCCR4A = 0;                      // timer 4: normal mode with OCR4C as top, clock set by each tone
+  TCCR4D = 0;
+  TCCR4E = 0;
+}
+
+
+void CartMusic::play(uint24_t address, bool loop)
+{
+  active = false; // tick leaves the song alone while it is changed
+  setTone(false, 0);
+  setTone(true, 0);
+  song = address;
+  this->loop = loop;
+  restart();
+  active = true;
+}
+
+
+void CartMusic::stop()
+{
+  active = false;
+  setTone(false, 0);
+  setTone(true, 0);
+}
+
+
+void CartMusic::restart()
+{
+  next = song;
+  wait = 0;
+  position = 0;
+  empty = 3;
+  fillHalf = 0;
+}
+
+
+void CartMusic::setTone(bool channel2, uint16_t value)
+{
+  if (!channel2)
+  {
+    if (value == 0)
+    {
+      TCCR3A = 0; // release pin
+      return;
+    }
+    OCR3A = value;
+    if (TCNT3 > value) TCNT3 = 0; // don't wait for the counter to wrap
+    TCCR3A = _BV(COM3A0);         // toggle OC3A on compare match
+  }
+  else
+  {
+    if (value == 0)
+    {
+      TCCR4A = 0;
+      return;
+    }
+    TCCR4B = value >> 12;         // prescaler
+    TC4H   = (value >> 8) & 0x03; // 10-bit top
+    OCR4C  = value;
+    TC4H   = 0;
+    OCR4A  = 0;
+    TCNT4  = 0;
+    TCCR4A = _BV(COM4A0);         // toggle OC4A on compare match
+  }
+}
+
+
+void CartMusic::tick()
+{
+  if (!active) return;
+  // refill a used up half, both halves are used up right after play
+  if (empty & (1 << fillHalf))
+  {
+    if (Cart::suspend())
+    {
+      Cart::readDataBytes(next, buffer + fillHalf * CART_MUSIC_HALF_SIZE, CART_MUSIC_HALF_SIZE);
+      Cart::resume();
+      next += CART_MUSIC_HALF_SIZE;
+      empty &= ~(1 << fillHalf);
+      fillHalf ^= 1;
+      refills++;
+    }
+    else busyRefills++;
+  }
+  if (wait && --wait) return;
+  // start all events that are due (events with 0 ticks to the next event start together)
+  do
+  {
+    uint8_t half = position < CART_MUSIC_HALF_SIZE ? 0 : 1;
+    if (empty & (1 << half)) return; // not read yet, try again on the next tick
+    uint8_t* event = buffer + position;
+    uint16_t value = (event[0] << 8) | event[1];
+    uint16_t ticks = (event[2] << 8) | event[3];
+    if (value == CART_MUSIC_END)
+    {
+      if (loop) restart();
+      else stop();
+      return;
+    }
+    setTone(ticks & CART_MUSIC_CHANNEL2, value);
+    wait = ticks & ~CART_MUSIC_CHANNEL2;
+    position += CART_MUSIC_EVENT_SIZE;
+    if ((position & (CART_MUSIC_HALF_SIZE - 1)) == 0)
+    {
+      empty |= 1 << half;
+      position &= sizeof(buffer) - 1;
+    }
+  }
+  while (wait == 0);
+}
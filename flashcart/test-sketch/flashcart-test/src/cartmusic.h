@@ -0,0 +1,59 @@
+#ifndef CART_MUSIC_H
+#define CART_MUSIC_H
+
+#include "cart.h"
+
+constexpr uint8_t  CART_MUSIC_EVENT_SIZE  = 4;      // timer value (16-bit), channel and ticks to the next event (16-bit)
+constexpr uint8_t  CART_MUSIC_HALF_EVENTS = 4;      // events per buffer half (one flash read each)
+constexpr uint16_t CART_MUSIC_TICK_HZ     = 1000;   // ticks per second assumed by music-converter.py
+constexpr uint16_t CART_MUSIC_END         = 0xFFFF; // timer value of the last event of a song
+constexpr uint16_t CART_MUSIC_CHANNEL2    = 0x8000; // channel bit in the second word of an event
+
+// Plays music streamed from the program data area (created by
+// music-converter.py) so songs do not use internal flash. Events are kept in
+// a double buffer of two halves of four events. tick() is called from a timer
+// interrupt of the sketch: it starts the events that are due and refills a
+// used up half with one flash read while the bus is free (see Cart::suspend).
+// When the bus is busy the refill is tried again on the next tick, the other
+// half holds the following events meanwhile.
+//
+// Channel 1 plays on speaker pin 1 using timer 3 and channel 2 on speaker pin
+// 2 using timer 4. Both timers toggle their pin in hardware so there is no
+// interrupt per tone period. Timer values are calculated by the converter so
+// tick() does no division. Sound is muted by arduboy.audio.off() as usual.
+//
+// ISR(TIMER1_COMPA_vect) { music.tick(); } // with timer 1 at 1000 ticks per second
+
+class CartMusic
+{
+  public:
+    void begin(); // sets up the tone timers
+
+    void play(uint24_t address, bool loop = false); // starts a song in the program data area
+
+    void stop(); // stops the song and silences both channels
+
+    bool playing() { return active; }
+
+    void tick(); // call from a timer interrupt CART_MUSIC_TICK_HZ times per second
+
+    volatile uint16_t refills;     // flash reads done by tick (copy with interrupts disabled)
+    volatile uint16_t busyRefills; // refills postponed because the bus was busy
+
+  private:
+    void restart();
+
+    void setTone(bool channel2, uint16_t value);
+
+    uint8_t  buffer[2 * CART_MUSIC_HALF_EVENTS * CART_MUSIC_EVENT_SIZE];
+    uint24_t song;     // first event
+    uint24_t next;     // events read into the next half
+    uint16_t wait;     // ticks until the next event
+    uint8_t  position; // next event in buffer
+    uint8_t  empty;    // bit per half that needs a refill
+    uint8_t  fillHalf; // half that is refilled next
+    bool     loop;
+    volatile bool active;
+};
+
+#endif
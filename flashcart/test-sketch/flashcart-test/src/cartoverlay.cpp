@@ -0,0 +1,68 @@
+#include "cartoverlay.h"
+
+static void flashPage(const uint8_t* dataInRam, uint16_t targetAddress) // see Cathy bootloader readme
+{
+ #ifdef ARDUINO_ARCH_AVR
+  uint8_t oldSREG = SREG;
+  asm volatile(
+    "    cli                   \n" //disable interrupts
+    "    call    %[vector]     \n" //flashPage vector
+    : "+x" (dataInRam),
+      "+z" (targetAddress)
+    : [vector] "i" (CART_OVERLAY_VECTOR)
+    : "r0", "r24", "r25"
+  );
+  SREG = oldSREG;
+ #endif
+}
+
+
+bool CartOverlay::begin(const uint8_t* region, uint16_t size)
+{
+  this->region = region;
+  this->size   = 0; // load refuses all modules when the region can't be used
+  valid = false;
+  // programming a page also erases anything else that shares it
+  if ((uintptr_t)region & (CART_OVERLAY_PAGE_SIZE - 1)) return false;
+  size &= ~(CART_OVERLAY_PAGE_SIZE - 1);
+  if ((uint32_t)(uintptr_t)region + size > CART_OVERLAY_FLASH_END) return false;
+  // the vector must be an rjmp followed by the bootloader signature
+  if (((pgm_read_word(CART_OVERLAY_VECTOR) & 0xF000) != 0xC000) ||
+      (pgm_read_word(CART_OVERLAY_VECTOR + 2) != CART_BOOT_SIGNATURE)) return false;
+  this->size = size;
+  return true;
+}
+
+
+bool CartOverlay::load(uint24_t module)
+{
+  if (valid && (module == loaded)) return true;
+  Cart::seekData(module);
+  uint16_t address = Cart::readPendingUInt16();
+  uint16_t length  = Cart::readPendingLastUInt16();
+  if ((address != (uint16_t)(uintptr_t)region) || (length == 0) || (length > size)) return false;
+  valid = false; // region is invalid while being programmed
+  uint8_t buffer[CART_OVERLAY_PAGE_SIZE];
+  module += CART_OVERLAY_HEADER_SIZE;
+  for (uint16_t offset = 0; offset < length; offset += CART_OVERLAY_PAGE_SIZE)
+  {
+    uint8_t count = length - offset < CART_OVERLAY_PAGE_SIZE ? length - offset : CART_OVERLAY_PAGE_SIZE;
+    memset(buffer + count, 0xFF, CART_OVERLAY_PAGE_SIZE - count); // erased flash value
+    Cart::readDataBytes(module + offset, buffer, count);
+    // only program pages that differ
+    const uint8_t* page = region + offset;
+    uint8_t i = 0;
+    while (buffer[i] == pgm_read_byte(page + i))
+      if (++i == CART_OVERLAY_PAGE_SIZE) break;
+    if (i == CART_OVERLAY_PAGE_SIZE)
+    {
+      pagesSkipped++;
+      continue;
+    }
+    flashPage(buffer, (uint16_t)(uintptr_t)page);
+    pagesWritten++;
+  }
+  loaded = module - CART_OVERLAY_HEADER_SIZE;
+  valid = true;
+  return true;
+}
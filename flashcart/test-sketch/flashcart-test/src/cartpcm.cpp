@@ -0,0 +1,65 @@
+#include "cartpcm.h"
+
+void CartPcm::begin(uint16_t rate)
+{
+  stop();
+  TCCR4B = _BV(CS40);              // timer 4: 8-bit fast PWM at clock / 256
+  TCCR4C = 0;
+  TCCR4D = 0;
+  TCCR4E = 0;
+  TC4H   = 0;
+  OCR4C  = 0xFF;
+  OCR4A  = CART_PCM_SILENCE;
+  TCCR1A = 0;                      // timer 1: CTC mode at the sample rate
+  TCCR1B = _BV(WGM12) | _BV(CS10);
+  OCR1A  = F_CPU / rate - 1;
+}
+
+
+void CartPcm::play(uint24_t address, uint24_t length)
+{
+  TIMSK1 = 0; // tick leaves the buffer alone while it is reset
+  sound = address;
+  this->length = length;
+  samplesRead = 0;
+  head = 0;
+  tail = 0;
+  underruns = 0;
+  active = true;
+  fill();
+  TCCR4A = _BV(COM4A0) | _BV(PWM4A); // OC4A and its complement drive the speaker
+  TIMSK1 = _BV(OCIE1A);
+}
+
+
+void CartPcm::stop()
+{
+  TIMSK1 = 0;
+  TCCR4A = 0;
+  active = false;
+}
+
+
+void CartPcm::fill()
+{
+  if (!active) return;
+  uint8_t free = tail - head - 1; // tick may play more samples meanwhile which only makes more room
+  if (free == CART_PCM_BUFFER_SIZE - 1 && samplesRead != 0) underruns++;
+  if (free < CART_PCM_MIN_FILL) return;
+  // read up to the end of the ring buffer and the rest from the start
+  while (free)
+  {
+    uint8_t h = head;
+    uint8_t count = CART_PCM_BUFFER_SIZE - h < free ? CART_PCM_BUFFER_SIZE - h : free;
+    uint24_t left = samplesRead < length ? length - samplesRead : 0;
+    if (left >= count) Cart::readDataBytes(sound + samplesRead, buffer + h, count);
+    else
+    {
+      if (left) Cart::readDataBytes(sound + samplesRead, buffer + h, left);
+      memset(buffer + h + left, CART_PCM_SILENCE, count - left);
+    }
+    samplesRead += count;
+    head = h + count; // samples are in the buffer before tick can see them
+    free -= count;
+  }
+}
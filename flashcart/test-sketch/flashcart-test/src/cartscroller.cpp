@@ -0,0 +1,169 @@
+#include "cartscroller.h"
+
+void CartScroller::begin(uint8_t* buffer, uint24_t tilemap, uint16_t mapWidth, uint24_t tiles, uint8_t tileWidth, uint8_t tileHeight)
+{
+  this->buffer    = buffer;
+  this->tilemap   = tilemap;
+  this->mapWidth  = mapWidth;
+  this->tiles     = tiles + 4; // skip bitmap width, height
+  this->tileWidth = tileWidth;
+  tilePages = tileHeight / 8;
+  valid = false;
+}
+
+
+void CartScroller::draw(uint16_t x, uint16_t y)
+{
+  int16_t dx = x - cameraX;
+  int16_t dy = y - cameraY;
+  cameraX = x;
+  cameraY = y;
+  cachedRow = 0xFFFF;
+  if (!valid || dx <= -WIDTH || dx >= WIDTH || dy <= -HEIGHT || dy >= HEIGHT)
+  {
+    fill(0, WIDTH, 0, HEIGHT / 8 - 1);
+    valid = true;
+    return;
+  }
+  // move the existing background by the camera delta
+  if (dx > 0) shiftLeft(dx);
+  else if (dx < 0) shiftRight(-dx);
+  if (dy > 0) shiftUp(dy);
+  else if (dy < 0) shiftDown(-dy);
+
+  // only read the newly exposed columns and rows from flash
+  uint8_t x0 = 0;
+  uint8_t x1 = WIDTH;
+  if (dx > 0)
+  {
+    x1 = WIDTH - dx;
+    fill(x1, WIDTH, 0, HEIGHT / 8 - 1);
+  }
+  else if (dx < 0)
+  {
+    x0 = -dx;
+    fill(0, x0, 0, HEIGHT / 8 - 1);
+  }
+  if (dy > 0) fill(x0, x1, (HEIGHT - dy) >> 3, HEIGHT / 8 - 1);
+  else if (dy < 0) fill(x0, x1, 0, (-dy - 1) >> 3);
+}
+
+
+void CartScroller::shiftLeft(uint8_t dx)
+{
+  for (uint8_t* row = buffer; row < buffer + WIDTH * HEIGHT / 8; row += WIDTH)
+    memmove(row, row + dx, WIDTH - dx);
+}
+
+
+void CartScroller::shiftRight(uint8_t dx)
+{
+  for (uint8_t* row = buffer; row < buffer + WIDTH * HEIGHT / 8; row += WIDTH)
+    memmove(row + dx, row, WIDTH - dx);
+}
+
+
+void CartScroller::shiftUp(uint8_t dy)
+{
+  // bit shift each column across pages. Pages are processed top to bottom so
+  // source pages are read before they are overwritten
+  uint8_t pages = dy >> 3;
+  uint8_t lshift = Cart::bitShiftLeftUInt8(8 - (dy & 7)); // shift by multiply
+  for (uint8_t* column = buffer; column < buffer + WIDTH; column++)
+  {
+    uint8_t* dest = column;
+    uint8_t* src  = column + pages * WIDTH;
+    for (uint8_t page = 0; page < HEIGHT / 8; page++)
+    {
+      uint8_t lower = 0;
+      uint8_t upper = 0;
+      if (page + pages < HEIGHT / 8) upper = *src;
+      if (page + pages + 1 < HEIGHT / 8) lower = src[WIDTH];
+      if (dy & 7) upper = (Cart::multiplyUInt8(upper, lshift) >> 8) | Cart::multiplyUInt8(lower, lshift);
+      *dest = upper;
+      dest += WIDTH;
+      src  += WIDTH;
+    }
+  }
+}
+
+
+void CartScroller::shiftDown(uint8_t dy)
+{
+  // bit shift each column across pages. Pages are processed bottom to top so
+  // source pages are read before they are overwritten
+  uint8_t pages = dy >> 3;
+  uint8_t lshift = Cart::bitShiftLeftUInt8(dy);
+  for (uint8_t* column = buffer; column < buffer + WIDTH; column++)
+  {
+    uint8_t* dest = column + (HEIGHT / 8 - 1) * WIDTH;
+    uint8_t* src  = dest - pages * WIDTH;
+    for (int8_t page = HEIGHT / 8 - 1; page >= 0; page--)
+    {
+      uint8_t lower = 0;
+      uint8_t upper = 0;
+      if (page - pages >= 0) lower = *src;
+      if (page - pages - 1 >= 0) upper = src[-WIDTH];
+      if (dy & 7) lower = Cart::multiplyUInt8(lower, lshift) | (Cart::multiplyUInt8(upper, lshift) >> 8);
+      *dest = lower;
+      dest -= WIDTH;
+      src  -= WIDTH;
+    }
+  }
+}
+
+
+void CartScroller::fill(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1)
+{
+  // display pages are not aligned with tile pages when cameraY is not a
+  // multiple of 8. Each display page is then combined from two tile pages
+  uint8_t  yshift = cameraY & 7;
+  uint8_t  lshift = Cart::bitShiftLeftUInt8(8 - yshift);
+  uint16_t worldPage = (cameraY >> 3) + page0;
+  uint8_t  segment1[CART_SCROLL_SEGMENT];
+  uint8_t  segment2[CART_SCROLL_SEGMENT];
+  for (uint8_t x = x0; x < x1;)
+  {
+    uint16_t worldX = cameraX + x;
+    uint8_t length = tileWidth - worldX % tileWidth; // don't cross a tile boundary
+    if (length > x1 - x) length = x1 - x;
+    if (length > CART_SCROLL_SEGMENT) length = CART_SCROLL_SEGMENT;
+    uint8_t* upper = segment1;
+    uint8_t* lower = segment2;
+    readWorldPage(worldPage, worldX, length, upper);
+    for (uint8_t page = page0; page <= page1; page++)
+    {
+      uint8_t* dest = buffer + page * WIDTH + x;
+      if (yshift)
+      {
+        readWorldPage(worldPage + page - page0 + 1, worldX, length, lower);
+        for (uint8_t i = 0; i < length; i++)
+          dest[i] = (Cart::multiplyUInt8(upper[i], lshift) >> 8) | Cart::multiplyUInt8(lower[i], lshift);
+        uint8_t* swap = upper;
+        upper = lower;
+        lower = swap;
+      }
+      else
+      {
+        memcpy(dest, upper, length);
+        if (page < page1) readWorldPage(worldPage + page - page0 + 1, worldX, length, upper);
+      }
+    }
+    x += length;
+  }
+}
+
+
+void CartScroller::readWorldPage(uint16_t worldPage, uint16_t worldX, uint8_t length, uint8_t* dest)
+{
+  uint16_t tileRow    = worldPage / tilePages;
+  uint8_t  tilePage   = worldPage % tilePages;
+  uint16_t tileColumn = worldX / tileWidth;
+  if ((tileRow != cachedRow) || (tileColumn != cachedColumn)) // tile index is reused for the pages of the same tile
+  {
+    cachedRow = tileRow;
+    cachedColumn = tileColumn;
+    Cart::readDataArray2D(tilemap, tileRow, tileColumn, mapWidth, &tile, 1);
+  }
+  Cart::readDataBytes(tiles + (uint24_t)(Cart::multiplyUInt8(tile, tilePages) + tilePage) * tileWidth + worldX % tileWidth, dest, length);
+}
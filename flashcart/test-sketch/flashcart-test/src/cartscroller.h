@@ -0,0 +1,48 @@
+#ifndef CART_SCROLLER_H
+#define CART_SCROLLER_H
+
+#include "cart.h"
+
+constexpr uint8_t CART_SCROLL_SEGMENT = 16; // maximum number of bytes read from a tile at once
+
+// Keeps a tilemap background in a 1K buffer (Arduboy2Base::sBuffer layout) and
+// only reads the newly exposed columns and rows from flash when the camera moves.
+// The tilemap is a byte array of tile indexes with mapWidth tiles per row. The
+// tiles are a normal (unmasked) bitmap with a tileHeight that is a multiple of 8.
+
+class CartScroller
+{
+  public:
+    void begin(uint8_t* buffer, uint24_t tilemap, uint16_t mapWidth, uint24_t tiles, uint8_t tileWidth, uint8_t tileHeight);
+
+    void draw(uint16_t cameraX, uint16_t cameraY); // update buffer for a new camera position
+
+    void redraw() // redraw the whole buffer on next draw (when tilemap data was changed)
+    {
+      valid = false;
+    };
+
+    uint8_t* buffer;    // background buffer. May be Arduboy2Base::sBuffer when nothing else is drawn
+    uint24_t tilemap;   // tilemap offset in program data area
+    uint24_t tiles;     // tile bitmap offset in program data area
+    uint16_t mapWidth;  // tiles per tilemap row
+    uint8_t  tileWidth;
+    uint8_t  tilePages; // tileHeight / 8
+
+  private:
+    void shiftLeft(uint8_t dx);
+    void shiftRight(uint8_t dx);
+    void shiftUp(uint8_t dy);
+    void shiftDown(uint8_t dy);
+    void fill(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1); // reads exposed area from flash
+    void readWorldPage(uint16_t worldPage, uint16_t worldX, uint8_t length, uint8_t* dest);
+
+    uint16_t cameraX;
+    uint16_t cameraY;
+    uint16_t cachedRow;  // tilemap location of last read tile
+    uint16_t cachedColumn;
+    uint8_t  tile;       // last read tile
+    bool     valid;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "cartworld.h"
+
+void CartWorld::begin(uint24_t tilemap, uint16_t mapWidth, uint16_t mapHeight, uint8_t tileWidth, uint8_t tileHeight)
+{
+  this->tilemap    = tilemap;
+  this->mapWidth   = mapWidth;
+  this->mapHeight  = mapHeight;
+  this->tileWidth  = tileWidth;
+  this->tileHeight = tileHeight;
+  for (uint8_t i = 0; i < CART_WORLD_CHUNKS; i++) chunks[i].x = 0xFFFF;
+  lastChunk = chunks;
+  directionX = 0;
+  directionY = 0;
+}
+
+
+void CartWorld::update(int16_t x, int16_t y)
+{
+  // remember direction of travel
+  if (x > cameraX) directionX = 1;
+  else if (x < cameraX) directionX = -1;
+  if (y > cameraY) directionY = 1;
+  else if (y < cameraY) directionY = -1;
+  cameraX = x;
+  cameraY = y;
+
+  // chunk ages saturate at 255 frames so a chunk unused for longer does not
+  // look recently used when the frame counter wraps
+  for (CartWorldChunk* chunk = chunks; chunk < chunks + CART_WORLD_CHUNKS; chunk++)
+    if ((uint8_t)(frame - chunk->used) == 0xFF) chunk->used++;
+  frame++;
+
+  // visible chunks are completed within the forced budget, the view is
+  // clamped to the map like the prefetch area
+  int16_t chunkWidth  = tileWidth << CART_WORLD_CHUNK_SHIFT;
+  int16_t chunkHeight = tileHeight << CART_WORLD_CHUNK_SHIFT;
+  int16_t lastX  = (mapWidth - 1) >> CART_WORLD_CHUNK_SHIFT;
+  int16_t lastY  = (mapHeight - 1) >> CART_WORLD_CHUNK_SHIFT;
+  int16_t left   = x < 0 ? 0 : x / chunkWidth;
+  int16_t top    = y < 0 ? 0 : y / chunkHeight;
+  int16_t right  = (x + WIDTH - 1) / chunkWidth;
+  int16_t bottom = (y + HEIGHT - 1) / chunkHeight;
+  if (right > lastX) right = lastX;
+  if (bottom > lastY) bottom = lastY;
+  uint8_t forced = 0;
+  for (int16_t cy = top; cy <= bottom; cy++)
+    for (int16_t cx = left; cx <= right; cx++)
+    {
+      CartWorldChunk* chunk = useChunk(cx, cy);
+      if (chunk == NULL) continue; // more visible chunks than fit, getTile reads from flash
+      while (chunk->rows < CART_WORLD_CHUNK_SIZE)
+      {
+        if (forced == forcedRowsPerUpdate)
+        {
+          deferredRows += CART_WORLD_CHUNK_SIZE - chunk->rows;
+          break;
+        }
+        loadRow(chunk);
+        forced++;
+      }
+    }
+  forcedRows += forced;
+  if (forced > maxForcedRows) maxForcedRows = forced;
+}
+
+
+void CartWorld::prefetch()
+{
+  // prefetch chunks that will become visible soon within budget. The area
+  // around the view is extended by the prefetch margin in direction of travel
+  // and by a quarter of the margin in other directions for sudden turns
+  int16_t chunkWidth  = tileWidth << CART_WORLD_CHUNK_SHIFT;
+  int16_t chunkHeight = tileHeight << CART_WORLD_CHUNK_SHIFT;
+  int16_t lastX  = (mapWidth - 1) >> CART_WORLD_CHUNK_SHIFT;
+  int16_t lastY  = (mapHeight - 1) >> CART_WORLD_CHUNK_SHIFT;
+  int16_t x = cameraX;
+  int16_t y = cameraY;
+  uint8_t budget = rowsPerUpdate;
+  uint8_t margin = prefetchMargin >> 2;
+  int16_t prefetchLeft   = x - (directionX < 0 ? prefetchMargin : margin);
+  int16_t prefetchRight  = x + WIDTH - 1 + (directionX > 0 ? prefetchMargin : margin);
+  int16_t prefetchTop    = y - (directionY < 0 ? prefetchMargin : margin);
+  int16_t prefetchBottom = y + HEIGHT - 1 + (directionY > 0 ? prefetchMargin : margin);
+  prefetchLeft   = prefetchLeft < 0 ? 0 : prefetchLeft / chunkWidth;
+  prefetchTop    = prefetchTop < 0 ? 0 : prefetchTop / chunkHeight;
+  prefetchRight  = prefetchRight / chunkWidth;
+  prefetchBottom = prefetchBottom / chunkHeight;
+  if (prefetchRight > lastX) prefetchRight = lastX;
+  if (prefetchBottom > lastY) prefetchBottom = lastY;
+  for (int16_t cy = prefetchTop; cy <= prefetchBottom; cy++)
+    for (int16_t cx = prefetchLeft; cx <= prefetchRight; cx++)
+    {
+      CartWorldChunk* chunk = useChunk(cx, cy);
+      if (chunk == NULL) return; // no free chunks
+      while (budget && (chunk->rows < CART_WORLD_CHUNK_SIZE))
+      {
+        loadRow(chunk);
+        prefetchedRows++;
+        budget--;
+      }
+    }
+}
+
+
+uint8_t CartWorld::getTile(uint16_t x, uint16_t y)
+{
+  CartWorldChunk* chunk = findChunk(x >> CART_WORLD_CHUNK_SHIFT, y >> CART_WORLD_CHUNK_SHIFT);
+  uint8_t row = y & (CART_WORLD_CHUNK_SIZE - 1);
+  if ((chunk == NULL) || (row >= chunk->rows))
+  {
+    uint8_t tile;
+    Cart::readDataArray2D(tilemap, y, x, mapWidth, &tile, 1);
+    return tile;
+  }
+  return chunk->tiles[(row << CART_WORLD_CHUNK_SHIFT) + (x & (CART_WORLD_CHUNK_SIZE - 1))];
+}
+
+
+void CartWorld::setTile(uint16_t x, uint16_t y, uint8_t tile)
+{
+  CartWorldChunk* chunk = findChunk(x >> CART_WORLD_CHUNK_SHIFT, y >> CART_WORLD_CHUNK_SHIFT);
+  uint8_t row = y & (CART_WORLD_CHUNK_SIZE - 1);
+  if ((chunk != NULL) && (row < chunk->rows))
+    chunk->tiles[(row << CART_WORLD_CHUNK_SHIFT) + (x & (CART_WORLD_CHUNK_SIZE - 1))] = tile;
+}
+
+
+CartWorldChunk* CartWorld::findChunk(uint16_t x, uint16_t y)
+{
+  if ((lastChunk->x == x) && (lastChunk->y == y)) return lastChunk; // consecutive tiles are mostly in same chunk
+  for (CartWorldChunk* chunk = chunks; chunk < chunks + CART_WORLD_CHUNKS; chunk++)
+    if ((chunk->x == x) && (chunk->y == y))
+    {
+      lastChunk = chunk;
+      return chunk;
+    }
+  return NULL;
+}
+
+
+CartWorldChunk* CartWorld::useChunk(uint16_t x, uint16_t y)
+{
+  CartWorldChunk* chunk = findChunk(x, y);
+  if (chunk == NULL)
+  {
+    // evict least recently used chunk that is not used this frame
+    uint8_t age = 0;
+    for (CartWorldChunk* c = chunks; c < chunks + CART_WORLD_CHUNKS; c++)
+      if ((uint8_t)(frame - c->used) > age || c->x == 0xFFFF)
+      {
+        age = c->x == 0xFFFF ? 0xFF : frame - c->used;
+        chunk = c;
+      }
+    if (chunk == NULL) return NULL;
+    chunk->x = x;
+    chunk->y = y;
+    chunk->rows = 0;
+  }
+  chunk->used = frame;
+  return chunk;
+}
+
+
+void CartWorld::loadRow(CartWorldChunk* chunk)
+{
+  uint16_t column = chunk->x << CART_WORLD_CHUNK_SHIFT;
+  uint16_t row = (chunk->y << CART_WORLD_CHUNK_SHIFT) + chunk->rows;
+  uint8_t length = CART_WORLD_CHUNK_SIZE;
+  if (column + length > mapWidth) length = column < mapWidth ? mapWidth - column : 0;
+  if (length && (row < mapHeight)) Cart::readDataArray2D(tilemap, row, column, mapWidth, chunk->tiles + (chunk->rows << CART_WORLD_CHUNK_SHIFT), length);
+  chunk->rows++;
+}
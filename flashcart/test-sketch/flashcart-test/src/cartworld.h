@@ -0,0 +1,78 @@
+#ifndef CART_WORLD_H
+#define CART_WORLD_H
+
+#include "cart.h"
+
+constexpr uint8_t CART_WORLD_CHUNK_SHIFT = 3;                           // chunks of 8 x 8 tiles
+constexpr uint8_t CART_WORLD_CHUNK_SIZE  = 1 << CART_WORLD_CHUNK_SHIFT;
+constexpr uint8_t CART_WORLD_CHUNKS      = 6;                           // 2 x 2 visible chunks + prefetched chunks
+constexpr uint8_t CART_WORLD_MIN_TILE    = 8;                           // smallest tile width and height that keeps all visible chunks resident
+constexpr uint8_t CART_WORLD_VISIBLE_CHUNKS = ((WIDTH - 1) / (CART_WORLD_MIN_TILE << CART_WORLD_CHUNK_SHIFT) + 2) *
+                                              ((HEIGHT - 1) / (CART_WORLD_MIN_TILE << CART_WORLD_CHUNK_SHIFT) + 2); // most chunks a view can touch
+
+static_assert(CART_WORLD_CHUNKS >= CART_WORLD_VISIBLE_CHUNKS, "CART_WORLD_CHUNKS must hold all chunks visible with the smallest tiles");
+
+struct CartWorldChunk
+{
+  uint16_t x;    // chunk location in chunks
+  uint16_t y;
+  uint8_t  rows; // number of tile rows loaded
+  uint8_t  used; // frame the chunk was last used (at most 255 frames ago)
+  uint8_t  tiles[CART_WORLD_CHUNK_SIZE * CART_WORLD_CHUNK_SIZE];
+};
+
+// Streams a large tilemap from flash into a small ring of chunks in RAM. The
+// chunks around the camera are kept resident and chunks in the direction of
+// travel are prefetched a few tile rows per frame so crossing a chunk boundary
+// does not require loading a whole chunk at once. Prefetching is done by
+// prefetch() after drawing so it uses time the frame would otherwise idle. The tilemap is a byte array of
+// tile indexes with mapWidth tiles per row (same as used with readDataArray).
+//
+// Rows of visible chunks that are not loaded yet are loaded immediately, up to
+// forcedRowsPerUpdate rows per update so a sudden turn does not cause a long
+// frame. Tiles in the remaining rows are read from flash one by one by getTile
+// until later updates have loaded them. With tiles smaller than
+// CART_WORLD_MIN_TILE not all visible chunks fit and getTile reads the tiles
+// of the chunks that did not fit from flash.
+
+class CartWorld
+{
+  public:
+    void begin(uint24_t tilemap, uint16_t mapWidth, uint16_t mapHeight, uint8_t tileWidth, uint8_t tileHeight);
+
+    void update(int16_t cameraX, int16_t cameraY); // call once per frame before drawing. Loads missing rows of visible chunks
+
+    void prefetch(); // call once per frame after drawing (before nextFrame). Loads rows of the chunks around the view
+
+    uint8_t getTile(uint16_t x, uint16_t y); // tile at tile location. Read from flash when chunk is not resident
+
+    void setTile(uint16_t x, uint16_t y, uint8_t tile); // change a tile. Change is lost when its chunk is evicted
+
+    uint8_t  rowsPerUpdate = 2;   // prefetch budget in chunk rows per frame
+    uint8_t  forcedRowsPerUpdate = 8; // most visible rows loaded immediately in one update
+    uint8_t  prefetchMargin = 48; // pixels ahead of the view in direction of travel that are prefetched
+    uint16_t forcedRows;        // rows that had to be loaded immediately (should stay 0 while moving)
+    uint16_t prefetchedRows;    // rows loaded by prefetching
+    uint16_t deferredRows;      // visible rows left to getTile because the forced budget was used up
+    uint8_t  maxForcedRows;     // most rows loaded immediately in one update
+
+  private:
+    CartWorldChunk* findChunk(uint16_t x, uint16_t y);
+    CartWorldChunk* useChunk(uint16_t x, uint16_t y); // find or allocate chunk
+    void loadRow(CartWorldChunk* chunk);
+
+    CartWorldChunk chunks[CART_WORLD_CHUNKS];
+    CartWorldChunk* lastChunk;
+    uint24_t tilemap;
+    uint16_t mapWidth;
+    uint16_t mapHeight;
+    uint8_t  tileWidth;
+    uint8_t  tileHeight;
+    int16_t  cameraX;
+    int16_t  cameraY;
+    int8_t   directionX;
+    int8_t   directionY;
+    uint8_t  frame;
+};
+
+#endif
@@ -0,0 +1,121 @@
+## Arduboy flashcart atlas packer 1.00 ##
+
+# packs sprite images into a single atlas bitmap for use with Cart::drawAtlasBitmap
+#
+# usage:
+#
+#   python atlas-packer.py [-w width] atlas.bin sprite.png [name=sprite.png ...]
+#
+#   Each image is a single sprite. Sprite names default to the filename
+#   without extension. When any image has transparency the atlas is a masked
+#   bitmap (use dbmMasked mode) and images without transparency are fully
+#   opaque. Otherwise only white pixels are kept so the atlas should be drawn
+#   using the dbmWhite, dbmBlack or dbmInvert mode. By default the atlas
+#   width that gives the smallest atlas is used. An atlas.h header with the sprite rectangles is created
+#   along with the atlas.
+#
+# atlas format:
+#
+#   regular bitmap: width, height (16-bit big endian) followed by the bitmap
+#   data of a single frame.
+#
+# Every sprite starts on a page row and owns the page rows it covers, so the
+# unused bits below a sprite are never shared with another sprite.
+
+import sys
+import os
+import re
+from PIL import Image
+
+MAX_WIDTH = 256
+
+def	usage():
+	print("usage: python atlas-packer.py [-w width] atlas.bin sprite.png [name=sprite.png ...]")
+	sys.exit()
+
+def	pages(height):
+	return (height + 7) // 8
+
+################################################################################
+
+args = sys.argv[1:]
+atlaswidth = 0
+if len(args) > 1 and args[0] == "-w":
+	atlaswidth = int(args[1])
+	args = args[2:]
+if len(args) < 2 or not 0 <= atlaswidth <= MAX_WIDTH:
+	usage()
+atlasfile = args[0]
+sprites = []
+for arg in args[1:]:
+	if "=" in arg:
+		name, filename = arg.split("=", 1)
+	else:
+		filename = arg
+		name = os.path.splitext(os.path.basename(arg))[0]
+	img = Image.open(filename).convert("RGBA")
+	sprites.append((name, img))
+masked = any(img.getextrema()[3][0] < 128 for name, img in sprites)
+
+# skyline packing in page rows, tallest sprites first. Each sprite is placed
+# at the lowest page row where it fits, leftmost first
+def	pack(atlaswidth):
+	skyline = [0] * atlaswidth
+	placed = {}
+	for name, img in sorted(sprites, key = lambda s: (-s[1].size[1], -s[1].size[0])):
+		width, height = img.size
+		left = min(range(atlaswidth - width + 1), key = lambda x: (max(skyline[x:x + width]), x))
+		page = max(skyline[left:left + width])
+		skyline[left:left + width] = [page + pages(height)] * width
+		placed[name] = (left, page)
+	return [(name, img) + placed[name] for name, img in sprites], max(skyline)
+
+maxwidth = max(img.size[0] for name, img in sprites)
+if atlaswidth == 0: # use the width that gives the smallest atlas
+	atlaswidth = min(range(maxwidth, MAX_WIDTH + 1), key = lambda w: (pack(w)[1] * w, w))
+if maxwidth > atlaswidth:
+	print("Sprites do not fit in an atlas {} pixels wide".format(atlaswidth))
+	sys.exit()
+placed, atlaspages = pack(atlaswidth)
+if atlaspages > 255:
+	print("Sprites do not fit in 255 page rows")
+	sys.exit()
+
+bitmap = bytearray(atlaspages * atlaswidth)
+mask = bytearray(atlaspages * atlaswidth)
+for name, img, left, page in placed:
+	pixels = img.load()
+	transparent = img.getextrema()[3][0] < 128
+	for y in range(img.size[1]):
+		for x in range(img.size[0]):
+			i = (page + y // 8) * atlaswidth + left + x
+			white = pixels[x, y][3] >= 128 and sum(pixels[x, y][:3]) >= 384
+			if white:
+				bitmap[i] |= 1 << (y & 7)
+			if pixels[x, y][3] >= 128 or not transparent:
+				mask[i] |= 1 << (y & 7)
+data = bytearray()
+for i in range(len(bitmap)):
+	data.append(bitmap[i])
+	if masked:
+		data.append(mask[i])
+atlasheight = atlaspages * 8
+header = bytearray([atlaswidth >> 8, atlaswidth & 0xFF, atlasheight >> 8, atlasheight & 0xFF])
+
+with open(atlasfile, "wb") as f:
+	f.write(header + data)
+headerfile = os.path.splitext(atlasfile)[0] + ".h"
+with open(headerfile, "w") as f:
+	f.write("//sprite rectangles for {} created by atlas-packer.py\n".format(os.path.basename(atlasfile)))
+	f.write("constexpr int16_t ATLAS_WIDTH  = {};\n".format(atlaswidth))
+	f.write("constexpr int16_t ATLAS_HEIGHT = {};\n".format(atlasheight))
+	for name, img, left, page in placed:
+		f.write("constexpr CartAtlasRect ATLAS_{} = {{{}, {}, {}, {}}};\n".format(
+			re.sub("[^A-Z0-9]", "_", name.upper()), left, page, img.size[0], img.size[1]))
+
+#report the size compared to separate bitmaps and to a sprite sheet with frames of the largest sprite size
+bytesperbyte = 2 if masked else 1
+separate = sum(4 + pages(img.size[1]) * img.size[0] * bytesperbyte for name, img in sprites)
+sheet = 4 + len(sprites) * pages(max(img.size[1] for name, img in sprites)) * maxwidth * bytesperbyte
+print("{} : {} sprites {}, {} x {} pixels".format(atlasfile, len(sprites), "masked" if masked else "unmasked", atlaswidth, atlasheight))
+print("separate bitmaps: {} bytes, sprite sheet: {} bytes, atlas: {} bytes".format(separate, sheet, len(header) + len(data)))
@@ -0,0 +1,141 @@
+## Arduboy flashcart asset directory builder 1.00 ##
+
+# combines asset files into a program data file with an asset directory at the
+# start so assets can be found by name using Cart::findAsset
+#
+# usage:
+#
+#   python directory-builder.py [-a alignment] datafile.bin asset.bin [name=asset.bin ...]
+#
+#   asset names default to the filename without extension. A datafile.h header
+#   with the asset key constants is created along with the data file.
+#
+# directory format:
+#
+#   header:        'DI', bucket bits, slot bits
+#   displacements: 2^bucket bits 16-bit big endian displacements
+#   slots:         2^slot bits entries of key (32-bit), offset (24-bit), size (24-bit)
+#
+# An asset key is the 32-bit FNV-1a hash of its name. The key selects a bucket
+# whose displacement is mixed with the key to find the slot (perfect hashing).
+# Finding an asset takes two reads: the displacement and the slot.
+
+import sys
+import os
+import re
+
+DIRECTORY_KEY = b"DI"
+ENTRY_SIZE = 10
+
+def	usage():
+	print("usage: python directory-builder.py [-a alignment] datafile.bin asset.bin [name=asset.bin ...]")
+	sys.exit()
+
+def	assetKey(name):
+	key = 2166136261
+	for c in bytearray(name.encode()):
+		key = ((key ^ c) * 16777619) & 0xFFFFFFFF
+	return key
+
+def	mix(key, seed):
+	#must match cart.cpp directoryMix
+	x = (key ^ (seed * 0x9E3779B9)) & 0xFFFFFFFF
+	x ^= x >> 16
+	x = (x * 0x7FEB352D) & 0xFFFFFFFF
+	x ^= x >> 15
+	return x
+
+def	bits(n):
+	b = 0
+	while (1 << b) < n:
+		b += 1
+	return b
+
+def	buildTable(keys, bucketbits, slotbits):
+	buckets = [[] for i in range(1 << bucketbits)]
+	for key in keys:
+		buckets[key & ((1 << bucketbits) - 1)].append(key)
+	displacements = [0] * len(buckets)
+	slots = [None] * (1 << slotbits)
+	for b in sorted(range(len(buckets)), key = lambda b: -len(buckets[b])):
+		if not buckets[b]:
+			break
+		for d in range(1, 0x10000):
+			s = [mix(key, d) & ((1 << slotbits) - 1) for key in buckets[b]]
+			if len(set(s)) == len(s) and all(slots[i] is None for i in s):
+				break
+		else:
+			return None
+		displacements[b] = d
+		for key, i in zip(buckets[b], s):
+			slots[i] = key
+	return displacements, slots
+
+################################################################################
+
+args = sys.argv[1:]
+alignment = 1
+if len(args) > 1 and args[0] == "-a":
+	alignment = int(args[1], 0)
+	args = args[2:]
+if len(args) < 2:
+	usage()
+datafile = args[0]
+assets = []
+for arg in args[1:]:
+	if "=" in arg:
+		name, filename = arg.split("=", 1)
+	else:
+		filename = arg
+		name = os.path.splitext(os.path.basename(arg))[0]
+	with open(filename, "rb") as f:
+		assets.append((name, bytearray(f.read())))
+
+keys = [assetKey(name) for name, data in assets]
+if len(set(keys)) != len(keys):
+	print("Asset names must be unique")
+	sys.exit()
+
+#find smallest perfect hash table
+bucketbits = bits(max(len(keys) // 4, 1))
+slotbits = max(bits(len(keys) * 5 // 4), 1)
+while True:
+	table = buildTable(keys, bucketbits, slotbits)
+	if table:
+		break
+	slotbits += 1
+displacements, slots = table
+
+#place assets after directory
+offset = 4 + 2 * len(displacements) + ENTRY_SIZE * len(slots)
+locations = {}
+data = bytearray()
+for (name, asset), key in zip(assets, keys):
+	padding = (-(offset + len(data))) % alignment
+	data += bytearray(padding)
+	locations[key] = (offset + len(data), len(asset))
+	data += asset
+
+directory = bytearray(DIRECTORY_KEY) + bytearray([bucketbits, slotbits])
+for d in displacements:
+	directory += bytearray([d >> 8, d & 0xFF])
+for key in slots:
+	if key is None:
+		directory += bytearray(ENTRY_SIZE)
+	else:
+		o, s = locations[key]
+		directory += bytearray([key >> 24, (key >> 16) & 0xFF, (key >> 8) & 0xFF, key & 0xFF,
+		                        o >> 16, (o >> 8) & 0xFF, o & 0xFF, s >> 16, (s >> 8) & 0xFF, s & 0xFF])
+
+with open(datafile, "wb") as f:
+	f.write(directory + data)
+headerfile = os.path.splitext(datafile)[0] + ".h"
+with open(headerfile, "w") as f:
+	f.write("//asset keys for {} created by directory-builder.py\n".format(os.path.basename(datafile)))
+	for name, asset in assets:
+		f.write('constexpr uint32_t ASSET_{} = cartAssetKey("{}");\n'.format(re.sub("[^A-Z0-9]", "_", name.upper()), name))
+
+print("{} : {} assets, {} buckets, {} slots, directory {} bytes, total {} bytes".format(
+	datafile, len(assets), len(displacements), len(slots), len(directory), len(directory) + len(data)))
+for (name, asset), key in zip(assets, keys):
+	print("  {:<24} key 0x{:08X} offset 0x{:06X} size {}".format(name, key, locations[key][0], locations[key][1]))
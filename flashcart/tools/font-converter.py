@@ -0,0 +1,120 @@
+## Arduboy flashcart font converter 1.00 ##
+
+# converts a font to the cart font format used by Cart::setFont and Cart::drawString
+#
+# usage:
+#
+#   python font-converter.py fontname_WxH.png [first char] [spacing]
+#     converts a bitmap font image. The image contains a grid of W x H pixel
+#     character cells in ASCII order starting with the first char (default 32)
+#
+#   python font-converter.py font.ttf size [size ...]
+#     renders a TrueType font in one or more pixel sizes (one file per size)
+#
+# font format:
+#
+#   header:  height, first char, char count, max width, spacing, line height
+#   glyphs:  char count (at most 255) glyphs of (1 + max width * pages) bytes each:
+#            width followed by column data (all pages of a column together)
+#
+# requires PIL (pillow) to be installed
+
+import sys
+import os
+from PIL import Image
+
+def	usage():
+	print("usage: python font-converter.py fontname_WxH.png [first char] [spacing]")
+	print("       python font-converter.py font.ttf size [size ...]")
+	sys.exit()
+
+def	glyphWidth(pixels, cellx, celly, cellwidth, cellheight):
+	#proportional width is position of the rightmost set pixel
+	width = 0
+	for x in range(cellwidth):
+		for y in range(cellheight):
+			if pixels[cellx + x, celly + y]:
+				width = x + 1
+				break
+	return width
+
+def	glyphColumns(pixels, cellx, celly, width, height):
+	data = bytearray()
+	for x in range(width):
+		for page in range(0, height, 8):
+			b = 0
+			for bit in range(8):
+				y = page + bit
+				if y < height and pixels[cellx + x, celly + y]:
+					b |= 1 << bit
+			data.append(b)
+	return data
+
+def	buildFont(glyphs, height, firstchar, spacing, lineheight):
+	#glyphs is a list of (width, column data) tuples
+	pages = (height + 7) // 8
+	maxwidth = max([g[0] for g in glyphs])
+	glyphsize = 1 + maxwidth * pages
+	font = bytearray([height, firstchar, len(glyphs), maxwidth, spacing, lineheight])
+	for width, data in glyphs:
+		glyph = bytearray([width]) + data
+		font += glyph + bytearray(glyphsize - len(glyph))
+	return font
+
+def	convertImage(filename, firstchar, spacing):
+	name = os.path.splitext(os.path.basename(filename))[0]
+	try:
+		cellwidth, cellheight = [int(v) for v in name.split('_')[-1].split('x')]
+	except:
+		print("Font image filename must end with _WxH (character cell size)")
+		sys.exit()
+	img = Image.open(filename).convert("L")
+	pixels = img.load()
+	glyphs = []
+	for celly in range(0, img.size[1] - cellheight + 1, cellheight):
+		for cellx in range(0, img.size[0] - cellwidth + 1, cellwidth):
+			width = glyphWidth(pixels, cellx, celly, cellwidth, cellheight)
+			if width == 0: #space and other empty glyphs
+				width = cellwidth // 2
+			glyphs.append((width, glyphColumns(pixels, cellx, celly, width, cellheight)))
+	glyphs = glyphs[:min(256 - firstchar, 255)] #char count is a byte: at most 255 glyphs
+	return buildFont(glyphs, cellheight, firstchar, spacing, cellheight + 1)
+
+def	convertTrueType(filename, size, firstchar = 32, lastchar = 126, spacing = 1):
+	from PIL import ImageFont, ImageDraw
+	ttf = ImageFont.truetype(filename, size)
+	ascent, descent = ttf.getmetrics()
+	height = ascent + descent
+	glyphs = []
+	for c in range(firstchar, lastchar + 1):
+		img = Image.new("L", (size * 2, height), 0)
+		ImageDraw.Draw(img).text((0, 0), chr(c), font = ttf, fill = 255)
+		pixels = img.point(lambda p: 255 if p >= 128 else 0).load()
+		width = glyphWidth(pixels, 0, 0, size * 2, height)
+		if width == 0:
+			width = size // 3
+		glyphs.append((width, glyphColumns(pixels, 0, 0, width, height)))
+	return buildFont(glyphs, height, firstchar, spacing, height + 1)
+
+def	writeFont(filename, font):
+	with open(filename, "wb") as f:
+		f.write(font)
+	print("{} : {} bytes, height {}, chars {}..{}".format(filename, len(font), font[0], font[1], font[1] + font[2] - 1))
+
+################################################################################
+
+if len(sys.argv) < 2:
+	usage()
+filename = sys.argv[1]
+basename = os.path.splitext(filename)[0]
+if filename.lower().endswith(".ttf"):
+	if len(sys.argv) < 3:
+		usage()
+	for size in sys.argv[2:]:
+		writeFont("{}_{}.bin".format(basename, size), convertTrueType(filename, int(size)))
+else:
+	firstchar = int(sys.argv[2], 0) if len(sys.argv) > 2 else 32
+	spacing = int(sys.argv[3], 0) if len(sys.argv) > 3 else 1
+	if not 0 <= firstchar <= 255:
+		usage()
+	writeFont(basename + ".bin", convertImage(filename, firstchar, spacing))
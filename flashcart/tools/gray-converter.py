@@ -0,0 +1,93 @@
+## Arduboy flashcart gray converter 1.00 ##
+
+# converts a grayscale sprite sheet to a planar gray bitmap for use with CartGray
+#
+# usage:
+#
+#   python gray-converter.py spritename_WxH.png
+#
+#   The image contains W x H pixel frames. Pixel brightness is reduced to 4
+#   gray levels: black, dark gray, light gray and white. Images with
+#   transparency use the transparent pixels as mask and give a masked bitmap.
+#
+# gray bitmap format:
+#
+#   header: width, height (16-bit big endian)
+#   frames: plane 0 and plane 1 of each frame as regular bitmap frames
+#
+#   A pixel of gray level n is set in plane 0 when bit 0 of n is set and in
+#   plane 1 when bit 1 is set. CartGray shows plane 1 twice as long as plane
+#   0. Plane p of frame f is frame f * 2 + p for Cart::drawBitmap, both planes
+#   of a masked bitmap have a copy of the mask.
+#
+# requires PIL (pillow) to be installed
+
+import sys
+import os
+from PIL import Image
+
+LEVELS = 4
+PLANES = 2
+
+def	usage():
+	print("usage: python gray-converter.py spritename_WxH.png")
+	sys.exit()
+
+def	planeData(level, opaque, masked, fx, fy, width, height, plane):
+	data = bytearray()
+	for page in range((height + 7) // 8):
+		for x in range(width):
+			b, m = 0, 0
+			for bit in range(8):
+				y = page * 8 + bit
+				if y < height:
+					if (level(fx + x, fy + y) >> plane) & 1:
+						b |= 1 << bit
+					if opaque(fx + x, fy + y):
+						m |= 1 << bit
+			data.append(b)
+			if masked:
+				data.append(m)
+	return data
+
+################################################################################
+
+if len(sys.argv) != 2:
+	usage()
+filename = sys.argv[1]
+name = os.path.splitext(os.path.basename(filename))[0]
+try:
+	framewidth, frameheight = [int(v) for v in name.split('_')[-1].split('x')]
+except:
+	print("Sprite filename must end with _WxH (frame size)")
+	sys.exit()
+
+img = Image.open(filename).convert("RGBA")
+pixels = img.load()
+masked = img.getextrema()[3][0] < 128
+opaque = lambda x, y: pixels[x, y][3] >= 128
+def	level(x, y):
+	if not opaque(x, y):
+		return 0
+	r, g, b = pixels[x, y][:3]
+	return int(round((r * 0.299 + g * 0.587 + b * 0.114) * (LEVELS - 1) / 255.0))
+
+data = bytearray()
+frames = 0
+used = [0] * LEVELS
+for fy in range(0, img.size[1] - frameheight + 1, frameheight):
+	for fx in range(0, img.size[0] - framewidth + 1, framewidth):
+		for plane in range(PLANES):
+			data += planeData(level, opaque, masked, fx, fy, framewidth, frameheight, plane)
+		for y in range(frameheight):
+			for x in range(framewidth):
+				if opaque(fx + x, fy + y):
+					used[level(fx + x, fy + y)] += 1
+		frames += 1
+header = bytearray([framewidth >> 8, framewidth & 0xFF, frameheight >> 8, frameheight & 0xFF])
+
+outfile = os.path.splitext(filename)[0] + ".bin"
+with open(outfile, "wb") as f:
+	f.write(header + data)
+print("{} : {} {}frames, {} bytes".format(outfile, frames, "masked " if masked else "", len(header) + len(data)))
+print("pixels per gray level (black to white): {}".format(", ".join(str(n) for n in used)))
@@ -0,0 +1,98 @@
+## Arduboy flashcart metatile converter 1.00 ##
+
+# converts a tilemap to the metatile map format used by CartMetatileMap
+#
+# usage:
+#
+#   python metatile-converter.py [-s size] tilemap.csv
+#   python metatile-converter.py [-s size] tilemap.bin width
+#
+#   A .csv tilemap has a line of comma separated tile numbers per tile row (as
+#   exported by the Tiled map editor). Tile numbers can be up to 65535. Any
+#   other file is a tilemap with a byte per tile and the given width in tiles.
+#   size is the width and height of a metatile in tiles: 2 (default) or 4.
+#
+# metatile map format:
+#
+#   header:    width, height (16-bit big endian, in tiles), metatile size,
+#              reserved, number of metatiles (16-bit big endian)
+#   map:       metatile number per metatile (16-bit little endian) in rows of
+#              (width + size - 1) / size metatiles
+#   metatiles: size x size tile numbers per metatile (16-bit little endian)
+#              in rows
+#
+# Each distinct group of size x size tiles is stored once. The map is padded
+# with tile 0 to a multiple of the metatile size. 16-bit values are stored
+# little endian so they are read straight into uint16_t arrays.
+
+import sys
+import os
+
+HEADER_SIZE = 8
+
+def	usage():
+	print("usage: python metatile-converter.py [-s size] tilemap.csv")
+	print("       python metatile-converter.py [-s size] tilemap.bin width")
+	sys.exit()
+
+def	word(value):
+	return bytearray([value & 0xFF, value >> 8])
+
+################################################################################
+
+args = sys.argv[1:]
+size = 2
+if len(args) > 1 and args[0] == "-s":
+	size = int(args[1])
+	args = args[2:]
+if len(args) < 1 or size not in (2, 4):
+	usage()
+filename = args[0]
+if filename.lower().endswith(".csv"):
+	with open(filename, "r") as f:
+		tilemap = [[int(v) for v in line.split(",") if v.strip() != ""] for line in f if line.strip() != ""]
+	width = len(tilemap[0])
+else:
+	if len(args) != 2:
+		usage()
+	width = int(args[1])
+	with open(filename, "rb") as f:
+		data = bytearray(f.read())
+	tilemap = [list(data[i:i + width]) for i in range(0, len(data) - width + 1, width)]
+height = len(tilemap)
+if any(len(row) != width for row in tilemap) or max(max(row) for row in tilemap) > 0xFFFF:
+	print("Tile rows must be of equal length and tile numbers below 65536")
+	sys.exit()
+
+tile = lambda x, y: tilemap[y][x] if x < width and y < height else 0
+mapwidth = (width + size - 1) // size
+mapheight = (height + size - 1) // size
+metatiles = []
+numbers = {}
+map = bytearray()
+for my in range(mapheight):
+	for mx in range(mapwidth):
+		group = tuple(tile(mx * size + x, my * size + y) for y in range(size) for x in range(size))
+		if group not in numbers:
+			numbers[group] = len(metatiles)
+			metatiles.append(group)
+		map += word(numbers[group])
+if len(metatiles) > 0xFFFF:
+	print("More than 65535 metatiles")
+	sys.exit()
+
+header = bytearray([width >> 8, width & 0xFF, height >> 8, height & 0xFF, size, 0, len(metatiles) >> 8 & 0xFF, len(metatiles) & 0xFF])
+table = bytearray()
+for group in metatiles:
+	for t in group:
+		table += word(t)
+
+outfile = os.path.splitext(filename)[0] + "-metatiles.bin"
+with open(outfile, "wb") as f:
+	f.write(header + map + table)
+
+#report the size compared to flat tilemaps
+total = len(header) + len(map) + len(table)
+print("{} : {} x {} tiles, {} metatiles of {} x {} tiles".format(outfile, width, height, len(metatiles), size, size))
+print("flat 8-bit map: {}, flat 16-bit map: {}, metatile map: {} bytes ({:.1f}x smaller than 16-bit)".format(
+	width * height if max(max(row) for row in tilemap) < 256 else "-", width * height * 2, total, width * height * 2.0 / total))
@@ -0,0 +1,125 @@
+## Arduboy flashcart music converter 1.00 ##
+
+# converts a song to the event stream played by CartMusic
+#
+# usage:
+#
+#   python music-converter.py song.h
+#   python music-converter.py song.csv
+#
+#   A .h file holds an ArduboyTones style array of frequency, duration pairs
+#   (NOTE_ names, numbers, TONES_END / TONES_REPEAT) and is played on channel 1.
+#   A .csv file has a line per note: start time (ms), channel (1 or 2),
+#   frequency (Hz, 0 for silence). Notes on a channel last until the next
+#   note on that channel.
+#
+# event format (4 bytes, 16-bit values big endian):
+#
+#   timer value: channel 1: timer 3 compare value (clock / 8, CTC toggle)
+#                channel 2: timer 4 prescaler select << 12 | 10-bit top
+#                0 = silence, 0xFFFF = end of song
+#   ticks:       bit 15 set for channel 2, bits 14-0 ticks (ms) to the next event
+#
+# Timer values are calculated here so the interrupt handler that plays the
+# song does no division.
+
+import sys
+import os
+import re
+
+F_CPU = 16000000
+TICK_HZ = 1000
+MAX_TICKS = 0x7FFF
+END = 0xFFFF
+CHANNEL2 = 0x8000
+SEMITONES = {"C" : 0, "D" : 2, "E" : 4, "F" : 5, "G" : 7, "A" : 9, "B" : 11}
+
+def	usage():
+	print("usage: python music-converter.py song.h")
+	print("       python music-converter.py song.csv")
+	sys.exit()
+
+def	noteFrequency(name):
+	# ArduboyTones note names like NOTE_C5, NOTE_AS4 and NOTE_C5H (high volume)
+	if name == "NOTE_REST":
+		return 0
+	m = re.match(r"NOTE_([A-G])(S?)(\d)H?$", name)
+	if m is None:
+		print("Unknown note {}".format(name))
+		sys.exit()
+	semitone = SEMITONES[m.group(1)] + (1 if m.group(2) else 0) + int(m.group(3)) * 12
+	return 440.0 * 2 ** ((semitone - 57) / 12.0)
+
+def	timerValue(channel, frequency):
+	if frequency == 0:
+		return 0
+	if channel == 1:
+		value = int(round(F_CPU / 8 / 2.0 / frequency)) - 1
+		if not 0 < value < END:
+			print("Frequency {} Hz out of range for channel 1".format(frequency))
+			sys.exit()
+		return value
+	for select in range(1, 16):
+		top = int(round(F_CPU / 2 ** (select - 1) / 2.0 / frequency)) - 1
+		if 0 < top <= 0x3FF:
+			return select << 12 | top
+	print("Frequency {} Hz out of range for channel 2".format(frequency))
+	sys.exit()
+
+def	readTones(filename):
+	# returns list of (start ms, channel, frequency) and loop flag
+	with open(filename, "r") as f:
+		text = re.sub(r"//.*|/\*.*?\*/", "", f.read(), flags = re.S)
+	body = text[text.index("{") + 1 : text.index("}")]
+	tokens = [t.strip() for t in body.split(",") if t.strip() != ""]
+	notes = []
+	time = 0
+	for i in range(0, len(tokens), 2):
+		if tokens[i] in ("TONES_END", "TONES_REPEAT"):
+			return notes + [(time, 1, 0)], tokens[i] == "TONES_REPEAT"
+		frequency = noteFrequency(tokens[i]) if tokens[i].startswith("NOTE_") else int(tokens[i], 0) & 0x7FFF
+		notes.append((time, 1, frequency))
+		time += int(tokens[i + 1], 0)
+	return notes + [(time, 1, 0)], False
+
+def	readCsv(filename):
+	notes = []
+	with open(filename, "r") as f:
+		for line in f:
+			values = [v.strip() for v in line.split(",")]
+			if len(values) < 3 or not values[0].isdigit():
+				continue
+			notes.append((int(values[0]), int(values[1]), float(values[2])))
+	return notes, False
+
+################################################################################
+
+if len(sys.argv) != 2:
+	usage()
+filename = sys.argv[1]
+if filename.lower().endswith(".csv"):
+	notes, repeat = readCsv(filename)
+else:
+	notes, repeat = readTones(filename)
+notes.sort(key = lambda note: note[0])
+if len(notes) == 0 or any(note[1] not in (1, 2) for note in notes):
+	print("No notes found or channel other than 1 or 2")
+	sys.exit()
+
+data = bytearray()
+for i, (start, channel, frequency) in enumerate(notes):
+	value = timerValue(channel, frequency)
+	ticks = (notes[i + 1][0] - start) * TICK_HZ // 1000 if i + 1 < len(notes) else 0
+	# longer gaps are split into events that repeat the tone
+	while ticks > MAX_TICKS:
+		data += bytearray([value >> 8, value & 0xFF, (MAX_TICKS >> 8) | (0x80 if channel == 2 else 0), MAX_TICKS & 0xFF])
+		ticks -= MAX_TICKS
+	flags = CHANNEL2 if channel == 2 else 0
+	data += bytearray([value >> 8, value & 0xFF, (ticks | flags) >> 8, (ticks | flags) & 0xFF])
+data += bytearray([END >> 8, END & 0xFF, 0, 0])
+
+outfile = os.path.splitext(filename)[0] + "-music.bin"
+with open(outfile, "wb") as f:
+	f.write(data)
+print("{} : {} events, {} bytes, {:.1f} seconds{}".format(outfile, len(data) // 4, len(data), notes[-1][0] / 1000.0,
+	" (song repeats, use play with loop)" if repeat else ""))
@@ -0,0 +1,72 @@
+## Arduboy flashcart overlay converter 1.00 ##
+
+# converts a code module in Intel hex format into an overlay module for use
+# with CartOverlay::load
+#
+# usage:
+#
+#   python overlay-converter.py module.hex [module.bin]
+#
+# The module must be linked at the address of the overlay region reserved by
+# the sketch (see readme.md).
+#
+# overlay module format:
+#
+#   header: load address, size (16-bit big endian)
+#   code:   size bytes
+
+import sys
+import os
+
+PAGE_SIZE = 128
+
+def	usage():
+	print("usage: python overlay-converter.py module.hex [module.bin]")
+	sys.exit()
+
+################################################################################
+
+if len(sys.argv) < 2:
+	usage()
+hexfile = sys.argv[1]
+binfile = sys.argv[2] if len(sys.argv) > 2 else os.path.splitext(hexfile)[0] + ".bin"
+
+memory = {}
+base = 0
+with open(hexfile, "r") as f:
+	for line in f:
+		line = line.strip()
+		if not line.startswith(":"):
+			continue
+		record = bytearray.fromhex(line[1:])
+		if sum(record) & 0xFF:
+			print("Checksum error in line: {}".format(line))
+			sys.exit()
+		length, address, recordtype = record[0], (record[1] << 8) | record[2], record[3]
+		data = record[4:4 + length]
+		if recordtype == 0:
+			for i, b in enumerate(data):
+				memory[base + address + i] = b
+		elif recordtype == 1:
+			break
+		elif recordtype == 2:
+			base = ((data[0] << 8) | data[1]) << 4
+		elif recordtype == 4:
+			base = ((data[0] << 8) | data[1]) << 16
+if not memory:
+	print("No data in {}".format(hexfile))
+	sys.exit()
+
+start = min(memory)
+end = max(memory) + 1
+if start % PAGE_SIZE:
+	print("Module address 0x{:04X} is not aligned to a {} byte page".format(start, PAGE_SIZE))
+	sys.exit()
+if end > 0x10000:
+	print("Module does not fit in 64K")
+	sys.exit()
+code = bytearray([memory.get(a, 0xFF) for a in range(start, end)])
+size = len(code)
+with open(binfile, "wb") as f:
+	f.write(bytearray([start >> 8, start & 0xFF, size >> 8, size & 0xFF]) + code)
+print("{} : address 0x{:04X}, {} bytes, {} pages".format(binfile, start, size, (size + PAGE_SIZE - 1) // PAGE_SIZE))
@@ -0,0 +1,86 @@
+## Arduboy flashcart PCM converter 1.00 ##
+
+# converts a .wav file to 8-bit unsigned PCM samples played by CartPcm
+#
+# usage:
+#
+#   python pcm-converter.py [-r rate] [-f fps] sound.wav
+#
+#   -r rate  sample rate in Hz, 8000 to 16000 (default 16000)
+#   -f fps   frames per second of an animation the sound goes with; prints
+#            the number of frames the sound lasts
+#
+# 8 or 16-bit .wav files with any number of channels and any sample rate are
+# accepted. Channels are mixed to mono and the sound is resampled to the rate
+# with linear interpolation. Output is sound-pcm.bin with one byte per sample.
+
+import sys
+import os
+import wave
+import struct
+
+def	usage():
+	print("usage: python pcm-converter.py [-r rate] [-f fps] sound.wav")
+	sys.exit()
+
+def	readWave(filename):
+	# returns list of mono samples from -1.0 to 1.0 and the sample rate
+	w = wave.open(filename, "rb")
+	channels = w.getnchannels()
+	width = w.getsampwidth()
+	rate = w.getframerate()
+	data = w.readframes(w.getnframes())
+	w.close()
+	if width == 1:
+		values = [(b - 128) / 128.0 for b in bytearray(data)]
+	elif width == 2:
+		values = [v / 32768.0 for v in struct.unpack("<{}h".format(len(data) // 2), data)]
+	else:
+		print("Only 8 and 16-bit .wav files are supported")
+		sys.exit()
+	samples = [sum(values[i : i + channels]) / channels for i in range(0, len(values), channels)]
+	return samples, rate
+
+def	resample(samples, rate, newRate):
+	length = int(len(samples) * newRate / rate)
+	result = []
+	for i in range(length):
+		position = i * rate / float(newRate)
+		index = int(position)
+		fraction = position - index
+		nextSample = samples[index + 1] if index + 1 < len(samples) else samples[index]
+		result.append(samples[index] * (1 - fraction) + nextSample * fraction)
+	return result
+
+################################################################################
+
+rate = 16000
+fps = 0
+filename = None
+args = sys.argv[1:]
+while args:
+	arg = args.pop(0)
+	if arg in ("-r", "-f") and args:
+		value = int(args.pop(0))
+		if arg == "-r":
+			rate = value
+		else:
+			fps = value
+	elif filename is None:
+		filename = arg
+	else:
+		usage()
+if filename is None or not 8000 <= rate <= 16000:
+	usage()
+
+samples, sourceRate = readWave(filename)
+if sourceRate != rate:
+	samples = resample(samples, sourceRate, rate)
+data = bytearray([min(255, max(0, int(round(s * 128 + 128)))) for s in samples])
+
+outfile = os.path.splitext(filename)[0] + "-pcm.bin"
+with open(outfile, "wb") as f:
+	f.write(data)
+print("{} : {} samples at {} Hz, {:.1f} seconds".format(outfile, len(data), rate, len(data) / float(rate)))
+if fps:
+	print("{} frames at {} fps".format(len(data) * fps // rate, fps))
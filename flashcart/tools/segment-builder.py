@@ -0,0 +1,76 @@
+## Arduboy flashcart segment builder 1.00 ##
+
+# combines segment files into a program data file with a segment table at the
+# start so a sketch can switch between segments at runtime using
+# Cart::loadSegments and Cart::selectSegment
+#
+# usage:
+#
+#   python segment-builder.py datafile.bin segment.bin [name=segment.bin ...]
+#
+#   segment names default to the filename without extension. A datafile.h
+#   header with the segment index constants is created along with the data file.
+#
+# segment table format:
+#
+#   header: 'SG', number of segments, reserved
+#   pages:  per segment the 16-bit big endian page relative to the program data page
+#
+# Each segment starts on a page boundary and is addressed from its own start,
+# so a segment can be rebuilt without changing the addresses used in other
+# segments or in the sketch.
+
+import sys
+import os
+import re
+
+SEGMENT_KEY = b"SG"
+MAX_SEGMENTS = 8
+PAGE_SIZE = 256
+
+def	usage():
+	print("usage: python segment-builder.py datafile.bin segment.bin [name=segment.bin ...]")
+	sys.exit()
+
+def	pad(data):
+	return data + bytearray((-len(data)) % PAGE_SIZE)
+
+################################################################################
+
+args = sys.argv[1:]
+if len(args) < 2:
+	usage()
+datafile = args[0]
+segments = []
+for arg in args[1:]:
+	if "=" in arg:
+		name, filename = arg.split("=", 1)
+	else:
+		filename = arg
+		name = os.path.splitext(os.path.basename(arg))[0]
+	with open(filename, "rb") as f:
+		segments.append((name, bytearray(f.read())))
+if len(segments) > MAX_SEGMENTS:
+	print("No more than {} segments are supported".format(MAX_SEGMENTS))
+	sys.exit()
+
+table = bytearray(SEGMENT_KEY) + bytearray([len(segments), 0])
+data = bytearray()
+pages = []
+for name, segment in segments:
+	page = (len(pad(table + bytearray(2 * len(segments)))) + len(data)) // PAGE_SIZE
+	pages.append(page)
+	table += bytearray([page >> 8, page & 0xFF])
+	data += pad(segment)
+
+with open(datafile, "wb") as f:
+	f.write(pad(table) + data)
+headerfile = os.path.splitext(datafile)[0] + ".h"
+with open(headerfile, "w") as f:
+	f.write("//segment indexes for {} created by segment-builder.py\n".format(os.path.basename(datafile)))
+	for i, (name, segment) in enumerate(segments):
+		f.write("constexpr uint8_t SEGMENT_{} = {};\n".format(re.sub("[^A-Z0-9]", "_", name.upper()), i))
+
+print("{} : {} segments, total {} bytes".format(datafile, len(segments), len(pad(table)) + len(data)))
+for (name, segment), page in zip(segments, pages):
+	print("  {:<24} page 0x{:04X} size {}".format(name, page, len(segment)))
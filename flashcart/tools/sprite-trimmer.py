@@ -0,0 +1,110 @@
+## Arduboy flashcart sprite trimmer 1.00 ##
+
+# converts a sprite sheet to the trimmed bitmap format used by Cart::drawTrimmedBitmap
+#
+# usage:
+#
+#   python sprite-trimmer.py spritename_WxH.png
+#
+#   The image contains W x H pixel frames. Images with transparency are
+#   converted to masked bitmaps (use dbmMasked mode). For images without
+#   transparency only white pixels are kept so they should be drawn using the
+#   dbmWhite, dbmBlack or dbmInvert mode.
+#
+# trimmed bitmap format:
+#
+#   header:      width, height (16-bit big endian, untrimmed frame size)
+#   frame table: per frame offset (24-bit), left, top, width, height
+#   frames:      bitmap data of each frame's trim rectangle
+#
+# requires PIL (pillow) to be installed
+
+import sys
+import os
+from PIL import Image
+
+ENTRY_SIZE = 7
+
+def	usage():
+	print("usage: python sprite-trimmer.py spritename_WxH.png")
+	sys.exit()
+
+def	trimRect(opaque, fx, fy, width, height):
+	left, top, right, bottom = width, height, -1, -1
+	for y in range(height):
+		for x in range(width):
+			if opaque(fx + x, fy + y):
+				left   = min(left, x)
+				right  = max(right, x)
+				top    = min(top, y)
+				bottom = max(bottom, y)
+	if right < 0:
+		return 0, 0, 0, 0
+	return left, top, right - left + 1, bottom - top + 1
+
+def	bitmapData(pixel, opaque, fx, fy, width, height, masked):
+	data = bytearray()
+	for page in range(0, height, 8):
+		for x in range(width):
+			b, m = 0, 0
+			for bit in range(8):
+				y = page + bit
+				if y < height:
+					if pixel(fx + x, fy + y):
+						b |= 1 << bit
+					if opaque(fx + x, fy + y):
+						m |= 1 << bit
+			data.append(b)
+			if masked:
+				data.append(m)
+	return data
+
+################################################################################
+
+if len(sys.argv) != 2:
+	usage()
+filename = sys.argv[1]
+name = os.path.splitext(os.path.basename(filename))[0]
+try:
+	framewidth, frameheight = [int(v) for v in name.split('_')[-1].split('x')]
+except:
+	print("Sprite filename must end with _WxH (frame size)")
+	sys.exit()
+
+img = Image.open(filename).convert("RGBA")
+pixels = img.load()
+masked = img.getextrema()[3][0] < 128
+pixel = lambda x, y: pixels[x, y][3] >= 128 and sum(pixels[x, y][:3]) >= 384
+if masked:
+	opaque = lambda x, y: pixels[x, y][3] >= 128
+else:
+	opaque = pixel
+
+frames = []
+for fy in range(0, img.size[1] - frameheight + 1, frameheight):
+	for fx in range(0, img.size[0] - framewidth + 1, framewidth):
+		left, top, width, height = trimRect(opaque, fx, fy, framewidth, frameheight)
+		frames.append((left, top, width, height, bitmapData(pixel, opaque, fx + left, fy + top, width, height, masked)))
+
+table = bytearray()
+data = bytearray()
+offset = 4 + len(frames) * ENTRY_SIZE
+for left, top, width, height, frame in frames:
+	table += bytearray([(offset >> 16) & 0xFF, (offset >> 8) & 0xFF, offset & 0xFF, left, top, width, height])
+	data += frame
+	offset += len(frame)
+header = bytearray([framewidth >> 8, framewidth & 0xFF, frameheight >> 8, frameheight & 0xFF])
+
+outfile = os.path.splitext(filename)[0] + ".bin"
+with open(outfile, "wb") as f:
+	f.write(header + table + data)
+
+#report savings compared to the untrimmed bitmap format
+bytesperbyte = 2 if masked else 1
+untrimmed = 4 + len(frames) * ((frameheight + 7) // 8) * framewidth * bytesperbyte
+trimmed = len(header) + len(table) + len(data)
+print("{} : {} frames {}".format(outfile, len(frames), "masked" if masked else "unmasked"))
+print("untrimmed size: {} bytes, trimmed size: {} bytes, saved: {} bytes".format(untrimmed, trimmed, untrimmed - trimmed))
+print("average bytes streamed per draw: untrimmed {}, trimmed {}".format(
+	((frameheight + 7) // 8) * framewidth * bytesperbyte,
+	len(data) // max(len(frames), 1)))